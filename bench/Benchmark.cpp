@@ -0,0 +1,509 @@
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../src/include/WindowService.h"
+#include "../src/include/DeviceService.h"
+#include "../src/include/FrameScheduler.h"
+#include "../src/include/UploadService.h"
+#include "../src/include/BufferService.h"
+#include "../src/include/SwapChainService.h"
+#include "../src/include/PipelineService.h"
+#include "../src/include/CullingService.h"
+#include "../src/include/CommandService.h"
+#include "../src/include/DrawList.h"
+// Generated by the AURELIUS_REVISION target
+#include "AureliusRevision.h"
+
+// Reproducible benchmark suite. Synthetic scenes (many cubes, many unique meshes, many pipelines,
+// large vertex counts) go through the real services on a headless device. Per scene it measures
+// upload throughput, CPU record time (serial and split across the worker pool) and full frame times,
+// and writes everything to JSON so runs can be compared between revisions.
+//
+// aurelius_bench [--frames N] [--scene NAME] [--json FILE]
+
+static constexpr int WIDTH = 800;
+static constexpr int HEIGHT = 600;
+static constexpr int DESCRIPTOR_SET_COUNT = 4;
+static constexpr int WARMUP_ITERATIONS = 3;
+static constexpr int MEASURED_ITERATIONS = 20;
+static constexpr uint32_t WARMUP_FRAMES = 30;
+static constexpr uint32_t DEFAULT_FRAMES = 300;
+static constexpr uint32_t SEED = 1234;
+
+// gridSize 0 = cubes, otherwise every mesh is a gridSize x gridSize vertex grid (at most 256, indices are 16 bit)
+struct SceneDesc {
+    std::string name;
+    uint32_t objectCount;
+    uint32_t meshCount;
+    uint32_t pipelineCount;
+    uint32_t gridSize;
+};
+
+static const std::vector<SceneDesc> SCENES = {
+    {"cubes_1k", 1000, 1, 1, 0},
+    {"cubes_10k", 10000, 1, 1, 0},
+    {"cubes_100k", 100000, 1, 1, 0},
+    {"unique_meshes_1k", 1000, 1000, 1, 0},
+    {"pipelines_64", 10000, 16, 64, 0},
+    {"large_meshes", 8, 8, 1, 256},
+};
+
+struct Summary {
+    double avg = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+struct SceneResult {
+    SceneDesc desc;
+    uint64_t vertexCount = 0;
+    uint64_t indexCount = 0;
+    double uploadMB = 0.0;
+    double uploadMs = 0.0;
+    double pipelineMs = 0.0;
+    // Per CPU-recorded frame, after instancing merged the repeated mesh + material runs
+    uint32_t drawCalls = 0;
+    Summary recordSerialMs;
+    Summary recordParallelMs;
+    Summary frameMs;
+    double gpuMs = 0.0;
+    VkDeviceSize peakVmaBytes = 0;
+};
+
+struct BenchOptions {
+    uint32_t frames = DEFAULT_FRAMES;
+    std::string scene;
+    std::string jsonPath = "aurelius_bench.json";
+};
+
+// Same construction order as Engine, so startup time covers what the game pays
+struct BenchServices {
+    // Nothing is presented, so no window either
+    WindowService windowService{WIDTH, HEIGHT, "AURELIUS BENCH", true};
+    DeviceService deviceService{windowService};
+    FrameScheduler frameScheduler{deviceService};
+    UploadService uploadService{deviceService, frameScheduler};
+    BufferService bufferService{deviceService, uploadService};
+    SwapChainService swapChainService{deviceService, windowService};
+    PipelineService pipelineService{deviceService, swapChainService};
+    CullingService cullingService{deviceService, frameScheduler, pipelineService, CommandService::DEFAULT_FRAMES_IN_FLIGHT};
+    CommandService commandService{deviceService, swapChainService, pipelineService, bufferService, uploadService, cullingService, frameScheduler};
+};
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    for (double sample : samples) {
+        summary.avg += sample;
+    }
+    summary.avg /= samples.size();
+
+    auto percentile = [&](size_t p) { return samples[std::min(samples.size() - 1, samples.size() * p / 100)]; };
+    summary.p50 = percentile(50);
+    summary.p90 = percentile(90);
+    summary.p99 = percentile(99);
+    summary.max = samples.back();
+    return summary;
+}
+
+// Device memory VMA holds (whole blocks, not just what is suballocated from them)
+static VkDeviceSize vmaBlockBytes(VmaAllocator allocator) {
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(allocator, &stats);
+    return stats.total.statistics.blockBytes;
+}
+
+// Looks down at the [-40, 40] cube the objects are scattered in
+static void benchCamera(VkExtent2D extent, glm::mat4& view, glm::mat4& proj) {
+    view = glm::lookAt(glm::vec3(0.0f, -60.0f, 90.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    proj = glm::perspective(glm::radians(45.0f), extent.width / static_cast<float>(extent.height), 0.1f, 500.0f);
+    proj[1][1] *= -1;
+}
+
+static void cubeMesh(float s, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices) {
+    vertices = {
+        {{-s, -s,  s}, {1.0f, 0.0f, 0.0f}}, {{ s, -s,  s}, {0.0f, 1.0f, 0.0f}},
+        {{ s,  s,  s}, {0.0f, 0.0f, 1.0f}}, {{-s,  s,  s}, {1.0f, 1.0f, 1.0f}},
+        {{-s, -s, -s}, {1.0f, 0.0f, 0.0f}}, {{ s, -s, -s}, {0.0f, 1.0f, 0.0f}},
+        {{ s,  s, -s}, {0.0f, 0.0f, 1.0f}}, {{-s,  s, -s}, {1.0f, 1.0f, 1.0f}}
+    };
+    indices = {
+        0, 1, 2, 2, 3, 0,   5, 4, 7, 7, 6, 5,   4, 0, 3, 3, 7, 4,
+        1, 5, 6, 6, 2, 1,   3, 2, 6, 6, 7, 3,   4, 5, 1, 1, 0, 4
+    };
+}
+
+// size x size vertex grid spanning [-extent, extent] on XY, with a gentle wave in Z
+static void gridMesh(uint32_t size, float extent, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices) {
+    vertices.clear();
+    indices.clear();
+    vertices.reserve(size * size);
+    indices.reserve((size - 1) * (size - 1) * 6);
+
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            float u = static_cast<float>(x) / (size - 1);
+            float v = static_cast<float>(y) / (size - 1);
+            float height = 0.5f * std::sin(u * 12.0f) * std::cos(v * 12.0f);
+            vertices.push_back({{(u * 2.0f - 1.0f) * extent, (v * 2.0f - 1.0f) * extent, height}, {u, v, 1.0f - u}});
+        }
+    }
+
+    for (uint32_t y = 0; y + 1 < size; y++) {
+        for (uint32_t x = 0; x + 1 < size; x++) {
+            uint16_t i = static_cast<uint16_t>(y * size + x);
+            uint16_t right = static_cast<uint16_t>(i + 1);
+            uint16_t below = static_cast<uint16_t>(i + size);
+            uint16_t diagonal = static_cast<uint16_t>(below + 1);
+            indices.insert(indices.end(), {i, right, diagonal, diagonal, below, i});
+        }
+    }
+}
+
+static BenchOptions parseArgs(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--scene" && i + 1 < argc) {
+            options.scene = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.jsonPath = argv[++i];
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    return options;
+}
+
+static void writeSummary(std::ofstream& file, const char* name, const Summary& summary) {
+    file << "\"" << name << "\":{\"avg\":" << summary.avg << ",\"p50\":" << summary.p50 << ",\"p90\":" << summary.p90
+         << ",\"p99\":" << summary.p99 << ",\"max\":" << summary.max << "}";
+}
+
+static void writeJson(const std::string& path, const std::string& gpuName, const BenchOptions& options, double startupMs,
+    VkDeviceSize peakVmaBytes, const MemoryBudget& memoryBudget, const std::vector<SceneResult>& results) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open benchmark results file " + path + "!");
+    }
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n";
+    file << "  \"revision\":\"" << AURELIUS_REVISION << "\",\n";
+    file << "  \"gpu\":\"" << gpuName << "\",\n";
+    file << "  \"frames\":" << options.frames << ",\n";
+    file << "  \"seed\":" << SEED << ",\n";
+    file << "  \"startupMs\":" << startupMs << ",\n";
+    file << "  \"peakVmaBytes\":" << peakVmaBytes << ",\n";
+
+    // Live bytes per allocation category at the end of the run
+    file << "  \"memoryBytes\":{";
+    for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); i++) {
+        MemoryCategory category = static_cast<MemoryCategory>(i);
+        file << (i > 0 ? "," : "") << "\"" << memoryCategoryName(category) << "\":" << memoryBudget.getCategoryBytes(category);
+    }
+    file << "},\n";
+    file << "  \"scenes\":[\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const SceneResult& result = results[i];
+        double uploadMBps = result.uploadMs > 0.0 ? result.uploadMB / (result.uploadMs / 1000.0) : 0.0;
+
+        file << "    {\"name\":\"" << result.desc.name << "\""
+             << ",\"objects\":" << result.desc.objectCount
+             << ",\"meshes\":" << result.desc.meshCount
+             << ",\"pipelines\":" << result.desc.pipelineCount
+             << ",\"vertices\":" << result.vertexCount
+             << ",\"indices\":" << result.indexCount
+             << ",\"uploadMB\":" << result.uploadMB
+             << ",\"uploadMs\":" << result.uploadMs
+             << ",\"uploadMBps\":" << uploadMBps
+             << ",\"pipelineMs\":" << result.pipelineMs
+             << ",\"drawCalls\":" << result.drawCalls << ",";
+        writeSummary(file, "recordSerialMs", result.recordSerialMs);
+        file << ",";
+        writeSummary(file, "recordParallelMs", result.recordParallelMs);
+        file << ",";
+        writeSummary(file, "frameMs", result.frameMs);
+        file << ",\"gpuMs\":" << result.gpuMs
+             << ",\"peakVmaBytes\":" << result.peakVmaBytes << "}"
+             << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    file << "  ]\n}\n";
+    std::cout << "\nResults written to " << path << std::endl;
+}
+
+static SceneResult runScene(BenchServices& services, const SceneDesc& scene, uint32_t frames,
+    const std::vector<VkDescriptorSet>& descriptorSets, VkCommandBuffer commandBuffer, VkDeviceSize& peakVmaBytes) {
+    DeviceService& deviceService = services.deviceService;
+    BufferService& bufferService = services.bufferService;
+    UploadService& uploadService = services.uploadService;
+    PipelineService& pipelineService = services.pipelineService;
+    CommandService& commandService = services.commandService;
+
+    SceneResult result;
+    result.desc = scene;
+
+    // Upload: generation happens up front so only uploadMesh through the transfer queue is timed
+    std::vector<std::vector<Vertex>> meshVertices(scene.meshCount);
+    std::vector<std::vector<uint16_t>> meshIndices(scene.meshCount);
+    for (uint32_t i = 0; i < scene.meshCount; i++) {
+        if (scene.gridSize > 0) {
+            gridMesh(scene.gridSize, 4.0f, meshVertices[i], meshIndices[i]);
+        } else {
+            cubeMesh(0.25f + 0.01f * (i % 50), meshVertices[i], meshIndices[i]);
+        }
+        result.vertexCount += meshVertices[i].size();
+        result.indexCount += meshIndices[i].size();
+    }
+    result.uploadMB = (result.vertexCount * sizeof(Vertex) + result.indexCount * sizeof(uint16_t)) / (1024.0 * 1024.0);
+
+    std::vector<Mesh> meshes;
+    meshes.reserve(scene.meshCount);
+    auto uploadStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < scene.meshCount; i++) {
+        meshes.push_back(bufferService.uploadMesh(meshVertices[i], meshIndices[i]));
+    }
+    uploadService.wait(uploadService.flush());
+    result.uploadMs = millisecondsSince(uploadStart);
+
+    // Distinct descs are distinct VkPipelines. The specialization constant id isn't declared by the shaders,
+    // which Vulkan ignores, so it only serves to make the descs differ.
+    std::vector<PipelineDesc> descs;
+    for (uint32_t i = 0; i < scene.pipelineCount; i++) {
+        PipelineDesc desc = PipelineDesc::opaque("shaders/vert.spv", "shaders/frag.spv");
+        desc.specializationConstants.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, 1000, i});
+        descs.push_back(desc);
+    }
+    auto pipelineStart = std::chrono::steady_clock::now();
+    std::vector<PipelineHandle> handles = pipelineService.prewarm(descs);
+    result.pipelineMs = millisecondsSince(pipelineStart);
+
+    std::vector<VkPipeline> pipelines;
+    for (PipelineHandle handle : handles) {
+        pipelines.push_back(pipelineService.resolvePipeline(handle));
+    }
+
+    result.peakVmaBytes = vmaBlockBytes(deviceService.getAllocator());
+
+    // The same unsorted packet every frame, built from a fixed seed
+    std::mt19937 rng(SEED);
+    std::uniform_int_distribution<uint32_t> meshDist(0, scene.meshCount - 1);
+    std::uniform_int_distribution<uint32_t> pipelineDist(0, scene.pipelineCount - 1);
+    std::uniform_int_distribution<int> setDist(0, DESCRIPTOR_SET_COUNT - 1);
+    std::uniform_real_distribution<float> posDist(-40.0f, 40.0f);
+
+    struct Object {
+        uint32_t mesh;
+        uint32_t pipeline;
+        int descriptorSet;
+        glm::mat4 transform;
+    };
+    std::vector<Object> objects(scene.objectCount);
+    for (Object& object : objects) {
+        object.mesh = meshDist(rng);
+        object.pipeline = pipelineDist(rng);
+        object.descriptorSet = setDist(rng);
+        object.transform = glm::translate(glm::mat4(1.0f), glm::vec3(posDist(rng), posDist(rng), posDist(rng)));
+    }
+
+    glm::mat4 view;
+    glm::mat4 proj;
+    benchCamera(services.swapChainService.getSwapChainExtent(), view, proj);
+
+    DrawList drawList;
+    drawList.reserve(scene.objectCount);
+    drawList.setViewProjection(proj * view);
+    auto buildDrawList = [&]() {
+        drawList.clear();
+        for (const Object& object : objects) {
+            drawList.add(meshes[object.mesh], pipelines[object.pipeline], descriptorSets[object.descriptorSet], object.transform);
+        }
+    };
+
+    // CPU record time: nothing is submitted, this isolates sort + state tracking + vkCmd* cost.
+    // Runs before any frame of the scene is in flight (the last scene ended idle), recording reuses the current slot's secondaries.
+    bool parallelRecording = commandService.isParallelRecording();
+    for (bool parallel : {false, true}) {
+        commandService.setParallelRecording(parallel);
+        std::vector<double> samples;
+
+        for (int iteration = 0; iteration < WARMUP_ITERATIONS + MEASURED_ITERATIONS; iteration++) {
+            buildDrawList();
+            vkResetCommandBuffer(commandBuffer, 0);
+
+            auto start = std::chrono::steady_clock::now();
+            commandService.recordDrawsOnly(commandBuffer, 0, drawList);
+            if (iteration >= WARMUP_ITERATIONS) {
+                samples.push_back(millisecondsSince(start));
+            }
+        }
+        (parallel ? result.recordParallelMs : result.recordSerialMs) = summarize(samples);
+        // Parallel chunks can split a run, so take the serial count
+        if (!parallel) {
+            result.drawCalls = commandService.getDrawCallCount();
+        }
+    }
+    commandService.setParallelRecording(parallelRecording);
+
+    // Full frames into the offscreen targets: draw list build, cull, record, submit, and waiting for a free slot
+    std::vector<double> frameSamples;
+    frameSamples.reserve(frames);
+    for (uint32_t frame = 0; frame < WARMUP_FRAMES + frames; frame++) {
+        auto start = std::chrono::steady_clock::now();
+
+        commandService.waitForFrameSlot();
+        buildDrawList();
+        commandService.drawFrame(drawList);
+
+        if (frame >= WARMUP_FRAMES) {
+            frameSamples.push_back(millisecondsSince(start));
+        }
+    }
+    result.frameMs = summarize(frameSamples);
+    result.gpuMs = commandService.getTelemetry().getAverage().gpuTime;
+
+    result.peakVmaBytes = std::max(result.peakVmaBytes, vmaBlockBytes(deviceService.getAllocator()));
+    peakVmaBytes = std::max(peakVmaBytes, result.peakVmaBytes);
+
+    // Idle, so the freed arena ranges are back before the next scene uploads
+    vkDeviceWaitIdle(deviceService.device());
+    for (const Mesh& mesh : meshes) {
+        bufferService.destroyMesh(mesh);
+    }
+    deviceService.getDeletionQueue().flush();
+
+    std::cout << std::left << std::setw(18) << scene.name << std::right << std::fixed << std::setprecision(3)
+              << " upload " << result.uploadMB << "MB in " << result.uploadMs << "ms"
+              << " | " << result.drawCalls << " draws"
+              << " | record " << result.recordSerialMs.avg << "ms / " << result.recordParallelMs.avg << "ms (parallel)"
+              << " | frame p50 " << result.frameMs.p50 << "ms p99 " << result.frameMs.p99 << "ms"
+              << " | GPU " << result.gpuMs << "ms" << std::endl;
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    try {
+        BenchOptions options = parseArgs(argc, argv);
+
+        auto startupStart = std::chrono::steady_clock::now();
+        auto services = std::make_unique<BenchServices>();
+        double startupMs = millisecondsSince(startupStart);
+
+        DeviceService& deviceService = services->deviceService;
+        PipelineService& pipelineService = services->pipelineService;
+
+        VkDeviceSize peakVmaBytes = vmaBlockBytes(deviceService.getAllocator());
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(deviceService.physicalDevice(), &properties);
+
+        // One fixed camera for every set, the vertex shader reads it
+        VkBuffer uniformBuffer;
+        VmaAllocation uniformAllocation;
+        services->bufferService.createBuffer(sizeof(FrameConstants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
+            uniformBuffer, uniformAllocation, MemoryCategory::Uniform);
+
+        FrameConstants camera{};
+        benchCamera(services->swapChainService.getSwapChainExtent(), camera.view, camera.proj);
+        camera.viewProj = camera.proj * camera.view;
+
+        void* mapped;
+        vmaMapMemory(deviceService.getAllocator(), uniformAllocation, &mapped);
+        memcpy(mapped, &camera, sizeof(camera));
+        vmaUnmapMemory(deviceService.getAllocator(), uniformAllocation);
+
+        DescriptorAllocator& descriptorAllocator = deviceService.getDescriptorAllocator();
+        VkDescriptorSetLayout layout = pipelineService.getDescriptorSetLayout();
+
+        VkDescriptorUpdateTemplateEntry entry{};
+        entry.dstBinding = 0;
+        entry.descriptorCount = 1;
+        entry.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        entry.offset = 0;
+        entry.stride = sizeof(VkDescriptorBufferInfo);
+        VkDescriptorUpdateTemplate updateTemplate = descriptorAllocator.createUpdateTemplate(layout, {entry});
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = uniformBuffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(camera);
+
+        // Separate sets all pointing at the same buffer, so descriptor set changes still show up in the record path
+        std::vector<VkDescriptorSet> descriptorSets(DESCRIPTOR_SET_COUNT);
+        for (VkDescriptorSet& descriptorSet : descriptorSets) {
+            descriptorSet = descriptorAllocator.allocate(layout);
+            descriptorAllocator.update(descriptorSet, updateTemplate, &bufferInfo);
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = deviceService.getCommandPool();
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(deviceService.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate benchmark command buffer!");
+        }
+
+        std::cout << "---------------------------------" << std::endl;
+        std::cout << "   AURELIUS BENCHMARK SUITE      " << std::endl;
+        std::cout << "---------------------------------" << std::endl;
+        std::cout << properties.deviceName << " | startup " << std::fixed << std::setprecision(3) << startupMs << "ms | "
+                  << options.frames << " frames per scene" << std::endl;
+
+        std::vector<SceneResult> results;
+        for (const SceneDesc& scene : SCENES) {
+            if (!options.scene.empty() && options.scene != scene.name) {
+                continue;
+            }
+            results.push_back(runScene(*services, scene, options.frames, descriptorSets, commandBuffer, peakVmaBytes));
+        }
+        if (results.empty()) {
+            throw std::runtime_error("Unknown scene: " + options.scene);
+        }
+
+        std::cout << "Peak VMA memory: " << peakVmaBytes / (1024.0 * 1024.0) << "MB" << std::endl;
+        descriptorAllocator.printReport();
+        writeJson(options.jsonPath, properties.deviceName, options, startupMs, peakVmaBytes, deviceService.getMemoryBudget(), results);
+
+        vkDeviceWaitIdle(deviceService.device());
+        vkFreeCommandBuffers(deviceService.device(), deviceService.getCommandPool(), 1, &commandBuffer);
+        deviceService.getMemoryBudget().untrack(uniformAllocation);
+        vmaDestroyBuffer(deviceService.getAllocator(), uniformBuffer, uniformAllocation);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
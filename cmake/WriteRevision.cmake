@@ -0,0 +1,17 @@
+# cmake -DSOURCE_DIR=... -DOUTPUT=... -P WriteRevision.cmake
+# Runs on every build. The header is only rewritten when the revision changed, so an unchanged HEAD rebuilds nothing.
+execute_process(
+    COMMAND git rev-parse --short HEAD
+    WORKING_DIRECTORY "${SOURCE_DIR}"
+    OUTPUT_VARIABLE REVISION
+    OUTPUT_STRIP_TRAILING_WHITESPACE
+    ERROR_QUIET
+)
+
+set(CONTENT "#pragma once\n#define AURELIUS_REVISION \"${REVISION}\"\n")
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" EXISTING)
+endif()
+if(NOT "${EXISTING}" STREQUAL "${CONTENT}")
+    file(WRITE "${OUTPUT}" "${CONTENT}")
+endif()
\ No newline at end of file
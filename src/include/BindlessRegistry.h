@@ -0,0 +1,79 @@
+#pragma once
+#include "DeviceService.h"
+#include "PipelineService.h"
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Bindings of the global bindless set (set 1 of the bindless pipeline layout), each one a partially bound,
+// update-after-bind array the shaders index with nonuniformEXT
+enum class BindlessBinding : uint32_t {
+    StorageBuffers,
+    SampledImages,
+    Samplers,
+    Count
+};
+
+// Push constants of the bindless pipelines: slots into the global set instead of per-draw descriptor sets
+struct BindlessConstants {
+    // Storage buffer slot of this frame's ObjectData, indexed by gl_InstanceIndex
+    uint32_t objectBuffer;
+};
+
+// The one descriptor set every bindless pipeline shares. Resources get a slot per binding when they are
+// registered and shaders look them up by that index, so the set is bound once per command buffer no matter
+// how many materials and objects are drawn. Owned by CommandService, render thread only.
+class BindlessRegistry {
+public:
+    static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+    // Does nothing (no pool, no set) when the device lacks descriptor indexing
+    BindlessRegistry(DeviceService& deviceService, PipelineService& pipelineService);
+    ~BindlessRegistry();
+
+    BindlessRegistry(const BindlessRegistry&) = delete;
+    BindlessRegistry& operator=(const BindlessRegistry&) = delete;
+
+    bool isSupported() const { return descriptorSet != VK_NULL_HANDLE; }
+    VkDescriptorSet getDescriptorSet() { return descriptorSet; }
+
+    // Writes the descriptor straight into the set (update-after-bind, so frames in flight don't care)
+    // and returns its slot. Throws when the binding is full.
+    uint32_t registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    uint32_t registerSampledImage(VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t registerSampler(VkSampler sampler);
+
+    // The slot is handed out again once the frames that may still index it have retired
+    void release(BindlessBinding binding, uint32_t slot);
+    // Once per frame with the completed graphics value, next to DeletionQueue::collect
+    void collect(uint64_t completedValue);
+
+    uint32_t getCapacity(BindlessBinding binding) const { return tables[static_cast<size_t>(binding)].capacity; }
+    uint32_t getUsed(BindlessBinding binding) const;
+
+private:
+    struct SlotTable {
+        uint32_t capacity = 0;
+        // Slots below this were handed out at least once
+        uint32_t highWater = 0;
+        std::vector<uint32_t> freeSlots;
+    };
+
+    struct PendingRelease {
+        uint64_t retireValue;
+        BindlessBinding binding;
+        uint32_t slot;
+    };
+
+    uint32_t allocateSlot(BindlessBinding binding);
+    void writeDescriptor(BindlessBinding binding, uint32_t slot, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo);
+
+    DeviceService& deviceService;
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    std::array<SlotTable, static_cast<size_t>(BindlessBinding::Count)> tables;
+    std::vector<PendingRelease> pendingReleases;
+};
\ No newline at end of file
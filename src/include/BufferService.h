@@ -1,35 +1,60 @@
 #pragma once
 #include "DeviceService.h"
+#include "UploadService.h"
+#include "StagingRing.h"
+#include "OffsetAllocator.h"
 #include "Mesh.h"
 #include "Vertex.h"
 class BufferService {
 public:
-    BufferService(DeviceService& deviceService);
+    static constexpr VkDeviceSize DEFAULT_STAGING_RING_SIZE = 64 * 1024 * 1024;
+    // Arena capacities are in elements (vertices / indices)
+    static constexpr uint32_t DEFAULT_VERTEX_ARENA_CAPACITY = 1024 * 1024;
+    static constexpr uint32_t DEFAULT_INDEX_ARENA_CAPACITY = 4 * 1024 * 1024;
+
+    BufferService(DeviceService& deviceService, UploadService& uploadService,
+        VkDeviceSize stagingRingSize = DEFAULT_STAGING_RING_SIZE,
+        uint32_t vertexArenaCapacity = DEFAULT_VERTEX_ARENA_CAPACITY,
+        uint32_t indexArenaCapacity = DEFAULT_INDEX_ARENA_CAPACITY);
     ~BufferService();
 
     BufferService(const BufferService&) = delete;
     BufferService& operator=(const BufferService&) = delete;
 
-    void createVertexBuffer();
-    void createIndexBuffer();
-
+    // Suballocates the mesh out of the shared arenas, so every mesh draws from the same two buffers
     Mesh uploadMesh(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices);
 
+    // Safe to call while frames using the mesh are in flight, the ranges are freed once they retire
     void destroyMesh(const Mesh& mesh);
 
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation);    
+    // Tracked under category in the device's MemoryBudget, untrack it before destroying the buffer directly
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation,
+        MemoryCategory category = MemoryCategory::Other);
+
+    // Stages data through the ring and records the copy into the current upload batch
+    UploadTicket uploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, VkSharingMode dstSharingMode = VK_SHARING_MODE_EXCLUSIVE);
     
     VkBuffer getVertexBuffer() { return vertexBuffer; }
     VkBuffer getIndexBuffer() { return indexBuffer; }
 
 private:
+    void createVertexBuffer();
+    void createIndexBuffer();
+    void createArenaBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation);
+
     DeviceService& deviceService;
+    UploadService& uploadService;
+
+    StagingRing stagingRing;
 
+    // Shared by the graphics and transfer families, so uploads into it need no ownership transfer
+    VkSharingMode arenaSharingMode;
+
+    OffsetAllocator vertexArena;
     VkBuffer vertexBuffer;
     VmaAllocation vertexBufferAllocation;
 
+    OffsetAllocator indexArena;
     VkBuffer indexBuffer;
     VmaAllocation indexBufferAllocation;
-
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 };
\ No newline at end of file
@@ -3,37 +3,153 @@
 #include "SwapChainService.h"
 #include "PipelineService.h"
 #include "BufferService.h"
+#include "UploadService.h"
+#include "CullingService.h"
+#include "FrameScheduler.h"
+#include "DrawList.h"
+#include "WorkerPool.h"
+#include "FrameTelemetry.h"
+#include "GpuProfiler.h"
+#include "UniformRing.h"
+#include "BindlessRegistry.h"
 #include <vulkan/vulkan.h>
+#include <atomic>
 #include <vector>
 
+// What the CPU-recorded path gives each draw, mirrors ObjectData in vert.vert and vert_bindless.vert (std430).
+// One array per frame in the ring. An instanced draw pushes the index of its first object in DrawConstants::objectIndex
+// and each instance adds gl_InstanceIndex.
+struct ObjectData {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
 class CommandService {
 public:
-    CommandService(DeviceService& device, SwapChainService& swapChain, PipelineService& pipeline, BufferService& buffer);
+    // 1 frame in flight for the lowest input latency, up to MAX_FRAMES_IN_FLIGHT for throughput
+    static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+    CommandService(DeviceService& device, SwapChainService& swapChain, PipelineService& pipeline, BufferService& buffer, UploadService& upload, CullingService& culling, FrameScheduler& frameScheduler,
+        uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
     ~CommandService();
 
     CommandService(const CommandService&) = delete;
     CommandService& operator=(const CommandService&) = delete;
 
-    const int MAX_FRAMES_IN_FLIGHT = 2;
-
+    // Throws unless 1 <= framesInFlight <= MAX_FRAMES_IN_FLIGHT, returns it otherwise
+    static uint32_t checkFramesInFlight(uint32_t framesInFlight);
+    uint32_t getFramesInFlight() const { return framesInFlight; }
     uint32_t currentFrame = 0;
 
-    VkResult drawFrame(const Mesh& mesh, VkDescriptorSet descriptorSet);
+    // Submit-to-retire latency and GPU idle time of the frames that retired so far
+    FrameTelemetry& getTelemetry() { return telemetry; }
+    // Per-pass GPU times and pipeline statistics
+    GpuProfiler& getProfiler() { return profiler; }
+
+    // Blocks until this frame's slot is free, which drawFrame would otherwise do first thing.
+    // Called before sampling input, so the input isn't stale by however long the GPU kept us waiting.
+    // Also resets the slot's per-frame descriptor sets, so allocateFrame for this frame has to come after it.
+    void waitForFrameSlot();
+
+    // Sorts the list and records every item into this frame's command buffer
+    VkResult drawFrame(DrawList& drawList);
+
+    // Benchmark only: sorts the list and records its draws into commandBuffer (begun and ended here, never submitted).
+    // Leaves out the upload acquire, object data writes, queries and culling, so no state a submitted frame depends on
+    // changes. Reuses the current slot's secondaries, so the slot's last submit must have retired.
+    void recordDrawsOnly(VkCommandBuffer commandBuffer, uint32_t imageIndex, DrawList& drawList);
+
+    // Splits big draw lists across the worker pool, each worker recording a secondary command buffer
+    void setParallelRecording(bool enabled) { parallelRecording = enabled; }
+    bool isParallelRecording() const { return parallelRecording; }
+
+    // Below this many draws per worker the threading overhead outweighs the recording
+    static constexpr uint32_t MIN_DRAWS_PER_WORKER = 512;
+
+    // Culls on the compute queue and draws through vkCmdDrawIndexedIndirectCount.
+    // Falls back to CPU recorded draws when the device can't do it or the list is too big.
+    void setGpuDrivenRendering(bool enabled) { gpuDrivenRendering = enabled; }
+    bool isGpuDrivenRendering() const { return gpuDrivenRendering; }
+
+    // CPU-recorded draws with the bindless pipeline variants: the global set is bound once per command buffer and
+    // object data is read through it instead of the object set. Off by default, and a no-op without
+    // descriptor indexing or while a pipeline in the list has no bindless variant.
+    void setBindlessRendering(bool enabled) { bindlessRendering = enabled; }
+    bool isBindlessRendering() const { return bindlessRendering; }
+    BindlessRegistry& getBindlessRegistry() { return bindlessRegistry; }
+
+    // vkCmdDrawIndexed calls the last CPU-recorded frame needed, after runs of the same mesh and material were instanced
+    uint32_t getDrawCallCount() const { return drawCalls.load(std::memory_order_relaxed); }
 
 private:
     void createCommandBuffers();
     void createSyncObjects();
-    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, const Mesh& mesh, VkDescriptorSet descriptorSet);
+    void createWorkerCommandPools();
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, DrawList& drawList);
+    // Chunks the list is split into for the worker pool, 1 = record on this thread
+    uint32_t getChunkCount(const DrawList& drawList);
+    void createObjectDataSet();
+    // Copies every draw's object data into this frame's ring region, in sorted order
+    void writeObjectData(const DrawList& drawList);
+    // Render pass, or dynamic rendering with the layout transitions around it
+    void beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool secondaries);
+    void endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordFrameState(VkCommandBuffer commandBuffer);
+    void recordDraws(VkCommandBuffer commandBuffer, const DrawList& drawList, size_t begin, size_t end);
+    void recordSecondaryCommandBuffers(uint32_t imageIndex, const DrawList& drawList, uint32_t chunkCount);
+    void recordIndirectDraws(VkCommandBuffer commandBuffer);
+    bool hasBindlessVariants(const DrawList& drawList);
 
     DeviceService& deviceService;
     SwapChainService& swapChainService;
     PipelineService& pipelineService;
     BufferService& bufferService;
+    UploadService& uploadService;
+    CullingService& cullingService;
+    FrameScheduler& frameScheduler;
+
+    uint32_t framesInFlight;
+    FrameTelemetry telemetry;
+    GpuProfiler profiler;
+
+    // Object data of the CPU path. One set covers a frame's region and is bound once per command buffer,
+    // after that a draw only pushes its index. Draw i of the sorted list is object i.
+    UniformRing uniformRing;
+    VkDescriptorSet objectDataSet;
+    // Dynamic offset of this frame's region
+    uint32_t objectDataOffset = 0;
+    std::atomic<uint32_t> drawCalls{0};
+
+    BindlessRegistry bindlessRegistry;
+    bool bindlessRendering = false;
+    // Whether the frame being recorded uses the bindless variants
+    bool bindlessFrame = false;
+    // Storage buffer slot of each frame's ring region, which the bindless vertex shader reads its objects from
+    std::vector<uint32_t> objectBufferSlots;
+
+    // Transfer timeline value the frame being recorded has to wait on (0 = none)
+    uint64_t uploadWaitValue = 0;
 
     std::vector<VkCommandBuffer> commandBuffers;
+
+    bool gpuDrivenRendering = true;
+    // Compute timeline value of this frame's culling pass (0 = list drawn the CPU way)
+    uint64_t cullWaitValue = 0;
+    bool listSorted = false;
+
+    bool parallelRecording = true;
+    WorkerPool workerPool{WorkerPool::defaultWorkerCount()};
+
+    // One pool per worker per frame in flight ([frame * workerCount + worker]), so workers never share a pool
+    std::vector<VkCommandPool> workerCommandPools;
+    std::vector<VkCommandBuffer> workerCommandBuffers;
     
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
+    // Graphics timeline value each frame slot signalled last, replaces the per-frame fences
+    std::vector<uint64_t> frameTimelineValues;
+    // Slot's timeline value when its per-frame descriptor sets were last reset, so waiting twice doesn't reset twice
+    std::vector<uint64_t> descriptorResetValues;
 
 };
\ No newline at end of file
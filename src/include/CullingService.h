@@ -0,0 +1,100 @@
+#pragma once
+#include "DeviceService.h"
+#include "PipelineService.h"
+#include "FrameScheduler.h"
+#include "DrawList.h"
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Mirrors ObjectData in cull.comp / vert_indirect.vert (std430, so the stride rounds up to 16)
+struct GpuObjectData {
+    glm::mat4 model;
+    glm::vec4 boundingSphere;
+    glm::vec4 color;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t batch;
+    uint32_t drawBase;
+    uint32_t padding[3];
+};
+static_assert(sizeof(GpuObjectData) == 128, "GpuObjectData must match the std430 layout in the shaders");
+
+// Push constants of the culling pass
+struct CullConstants {
+    glm::vec4 planes[6];
+    uint32_t objectCount;
+};
+
+// A run of objects that share pipeline and descriptor set. The culling pass compacts the
+// survivors into [drawBase, drawBase + maxDraws) of the draw buffer and counts them in counts[batch].
+struct IndirectBatch {
+    VkPipeline pipeline;
+    VkDescriptorSet descriptorSet;
+    uint32_t drawBase;
+    uint32_t maxDraws;
+};
+
+class CullingService {
+public:
+    static constexpr uint32_t DEFAULT_MAX_OBJECTS = 128 * 1024;
+
+    CullingService(DeviceService& deviceService, FrameScheduler& frameScheduler, PipelineService& pipelineService, uint32_t framesInFlight, uint32_t maxObjects = DEFAULT_MAX_OBJECTS);
+    ~CullingService();
+
+    CullingService(const CullingService&) = delete;
+    CullingService& operator=(const CullingService&) = delete;
+
+    // Needs drawIndirectCount; without it CommandService keeps recording draws on the CPU
+    bool isSupported() { return deviceService.supportsIndirectCount(); }
+    uint32_t getMaxObjects() const { return maxObjects; }
+
+    // Writes the (sorted) list into this frame's object buffer and submits the culling dispatch on the
+    // compute queue. Returns the compute timeline value at which the draw and count buffers are ready.
+    uint64_t cull(uint32_t frameIndex, const DrawList& drawList);
+
+    const std::vector<IndirectBatch>& getBatches() const { return batches; }
+    VkBuffer getDrawBuffer(uint32_t frameIndex) { return frames[frameIndex].drawBuffer; }
+    VkBuffer getCountBuffer(uint32_t frameIndex) { return frames[frameIndex].countBuffer; }
+    VkDescriptorSet getObjectSet(uint32_t frameIndex) { return frames[frameIndex].objectSet; }
+
+private:
+    struct FrameResources {
+        VkBuffer objectBuffer;
+        VmaAllocation objectAllocation;
+        GpuObjectData* objects;
+
+        VkBuffer drawBuffer;
+        VmaAllocation drawAllocation;
+
+        VkBuffer countBuffer;
+        VmaAllocation countAllocation;
+
+        VkDescriptorSet cullSet;
+        VkDescriptorSet objectSet;
+
+        VkCommandBuffer commandBuffer;
+    };
+
+    void createFrameResources();
+    void createDescriptorSets();
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation, void** mapped);
+    void buildBatches(const DrawList& drawList, GpuObjectData* objects);
+    CullConstants buildConstants(const glm::mat4& viewProjection, uint32_t objectCount);
+
+    DeviceService& deviceService;
+    FrameScheduler& frameScheduler;
+    PipelineService& pipelineService;
+
+    uint32_t framesInFlight;
+    uint32_t maxObjects;
+
+    // Compute writes the draws, graphics reads them, so share them when the families differ
+    std::vector<uint32_t> sharedFamilies;
+
+    std::vector<FrameResources> frames;
+
+    // Batches of the list culled last, in the order the draw buffer was laid out
+    std::vector<IndirectBatch> batches;
+};
\ No newline at end of file
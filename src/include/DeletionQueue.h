@@ -0,0 +1,58 @@
+#pragma once
+#include "vk_mem_alloc.h"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+class DeviceService;
+
+// Objects the GPU may still be reading get parked here, tagged with the graphics timeline value of the
+// last submit that could have used them, and are destroyed once that value has retired.
+// Render thread only.
+class DeletionQueue {
+public:
+    // DeviceService flushes it before tearing the device down
+    DeletionQueue(DeviceService& deviceService);
+
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    // Graphics timeline value of the next frame submit. Anything retired now may still be recorded into
+    // that frame, so it is the earliest safe value. CommandService moves it on after every submit.
+    uint64_t getRetireValue() { return retireValue; }
+    void setRetireValue(uint64_t value) { retireValue = value; }
+
+    // Runs destroy once the graphics timeline reaches retireValue (the current one if not given)
+    void push(std::function<void()> destroy);
+    void push(uint64_t retireValue, std::function<void()> destroy);
+
+    void destroyBuffer(VkBuffer buffer, VmaAllocation allocation);
+    void destroyImage(VkImage image, VmaAllocation allocation);
+    void destroyImageView(VkImageView imageView);
+    void destroyPipeline(VkPipeline pipeline);
+    void destroyFramebuffer(VkFramebuffer framebuffer);
+    void destroyRenderPass(VkRenderPass renderPass);
+    void destroyDescriptorPool(VkDescriptorPool descriptorPool);
+    void destroySwapchain(VkSwapchainKHR swapchain);
+
+    // Destroys everything the GPU is done with. Call once per frame with the completed graphics value.
+    void collect(uint64_t completedValue);
+    // Destroys everything regardless, only once the device is idle
+    void flush();
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        uint64_t retireValue;
+        std::function<void()> destroy;
+    };
+
+    DeviceService& deviceService;
+
+    // Starts at the first value FrameScheduler hands out
+    uint64_t retireValue = 1;
+    // In push order, which is retire order as long as values only go up
+    std::deque<Entry> entries;
+};
\ No newline at end of file
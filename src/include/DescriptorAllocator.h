@@ -0,0 +1,95 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class DeviceService;
+
+// Counters for the F8 report, since startup
+struct DescriptorStats {
+    uint64_t persistentSets = 0;
+    uint64_t frameSets = 0;
+    // Pools created after the first one of a chain, each one bigger than the last
+    uint32_t poolGrowths = 0;
+    uint32_t persistentPools = 0;
+    uint32_t framePools = 0;
+    uint64_t frameResets = 0;
+    uint32_t cachedLayouts = 0;
+    uint64_t templateUpdates = 0;
+};
+
+// Descriptor set layouts cached by their binding signature, plus sets handed out of growable pool chains.
+// A chain never runs dry: when its current pool is out of sets or descriptors it moves on to a new one
+// with twice the sets (up to MAX_SETS_PER_POOL). Persistent sets live as long as the device, per-frame
+// sets are all dropped at once by resetting their frame's pools. Owned by DeviceService, render thread only.
+class DescriptorAllocator {
+public:
+    static constexpr uint32_t INITIAL_SETS_PER_POOL = 64;
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    DescriptorAllocator(DeviceService& deviceService);
+
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+    // DeviceService calls it before the device goes, every layout, template and set is gone after it
+    void destroy();
+
+    // Same bindings (in any order), binding flags and create flags = same layout. Owned by the cache.
+    // bindingFlags is empty or one entry per binding, in the order given.
+    VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+        const std::vector<VkDescriptorBindingFlags>& bindingFlags = {}, VkDescriptorSetLayoutCreateFlags flags = 0);
+
+    // Lives until destroy, for sets that are written once at startup
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    // Valid until the frame slot comes around again and resetFrame is called
+    VkDescriptorSet allocateFrame(uint32_t frameIndex, VkDescriptorSetLayout layout);
+    // Resets every pool the slot used, one call per pool instead of one free per set.
+    // Once per frame, after the slot's previous submit has retired.
+    void resetFrame(uint32_t frameIndex);
+
+    // Owned by the allocator. entries offsets and strides point into the data passed to update.
+    VkDescriptorUpdateTemplate createUpdateTemplate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries);
+    // Writes every entry of the template in one call, without building VkWriteDescriptorSets
+    void update(VkDescriptorSet descriptorSet, VkDescriptorUpdateTemplate updateTemplate, const void* data);
+
+    DescriptorStats getStats() const;
+    void printReport() const;
+
+private:
+    struct PoolChain {
+        // The last one is the one being allocated from
+        std::vector<VkDescriptorPool> readyPools;
+        std::vector<VkDescriptorPool> fullPools;
+        uint32_t setsPerPool = INITIAL_SETS_PER_POOL;
+        uint32_t poolCount = 0;
+    };
+
+    struct LayoutKey {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        std::vector<VkDescriptorBindingFlags> bindingFlags;
+        VkDescriptorSetLayoutCreateFlags flags;
+
+        bool operator==(const LayoutKey& other) const;
+    };
+
+    struct LayoutKeyHash {
+        size_t operator()(const LayoutKey& key) const;
+    };
+
+    VkDescriptorSet allocateFrom(PoolChain& chain, VkDescriptorSetLayout layout);
+    // New pool of setsPerPool sets, the next one the chain needs gets twice as many
+    void addPool(PoolChain& chain);
+    void destroyChain(PoolChain& chain);
+
+    DeviceService& deviceService;
+
+    PoolChain persistentChain;
+    std::vector<PoolChain> frameChains;
+
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layoutCache;
+    std::vector<VkDescriptorUpdateTemplate> updateTemplates;
+
+    DescriptorStats stats;
+};
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 #include "WindowService.h"
+#include "DeletionQueue.h"
+#include "MemoryBudget.h"
+#include "DescriptorAllocator.h"
 #include "vk_mem_alloc.h"
 #include <vulkan/vulkan.h>
 #include <vector>
@@ -11,6 +14,15 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// Update-after-bind descriptor limits of a bindless set, per shader stage (0 without descriptor indexing)
+struct BindlessLimits {
+    uint32_t storageBuffers = 0;
+    uint32_t sampledImages = 0;
+    uint32_t samplers = 0;
+    // All of them together, plus whatever else the pipeline layout has
+    uint32_t resources = 0;
+};
+
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
@@ -33,6 +45,8 @@ class DeviceService {
 
         VkDevice device() { return device_; }
         VkSurfaceKHR surface() { return surface_; }
+        // No surface, no swapchain extension, presentQueue is the graphics queue
+        bool isHeadless() { return headless; }
         
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
@@ -41,6 +55,29 @@ class DeviceService {
         
         VkPhysicalDevice physicalDevice() { return physicalDevice_; }
         VkCommandPool getCommandPool() { return commandPool; }
+        VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+        VkCommandPool getComputeCommandPool() { return computeCommandPool; }
+
+        // drawIndirectCount + multiDrawIndirect + drawIndirectFirstInstance, needed for GPU-driven rendering
+        bool supportsIndirectCount() { return indirectCountSupported; }
+        // Vulkan 1.3 dynamicRendering + synchronization2
+        bool supportsDynamicRendering() { return dynamicRenderingSupported; }
+        // pipelineStatisticsQuery, and inheritedQueries for keeping them active across secondaries
+        bool supportsPipelineStatistics() { return pipelineStatisticsSupported; }
+        bool supportsInheritedQueries() { return inheritedQueriesSupported; }
+        // VK_EXT_memory_budget: real per-heap budgets from the driver instead of VMA's estimate
+        bool supportsMemoryBudget() { return memoryBudgetSupported; }
+        // Vulkan 1.2 descriptor indexing: partially bound, update-after-bind, runtime sized arrays
+        bool supportsBindless() { return bindlessSupported; }
+        const BindlessLimits& getBindlessLimits() { return bindlessLimits; }
+
+        // Timestamp queries on the graphics queue: 0 valid bits = not supported
+        uint32_t graphicsTimestampValidBits() { return timestampValidBits; }
+        // Nanoseconds per timestamp tick
+        float timestampPeriod() { return timestampPeriod_; }
+        // Samples a device timestamp and the host clock std::chrono::steady_clock reads (in ns) at the same moment,
+        // so GPU timestamps can be placed on the CPU timeline. False without VK_EXT_calibrated_timestamps.
+        bool getCalibratedTimestamps(uint64_t& deviceTimestamp, uint64_t& hostNanoseconds);
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice_); }
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice_); }
@@ -48,10 +85,15 @@ class DeviceService {
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-
         VmaAllocator getAllocator() { return allocator; }
 
+        // Deferred destruction for anything a frame in flight may still use
+        DeletionQueue& getDeletionQueue() { return deletionQueue; }
+        // Heap budgets and memory per category
+        MemoryBudget& getMemoryBudget() { return memoryBudget; }
+        // Descriptor set layout cache and growable descriptor pools
+        DescriptorAllocator& getDescriptorAllocator() { return descriptorAllocator; }
+
     private:
         void createInstance();
         void pickPhysicalDevice();
@@ -63,15 +105,32 @@ class DeviceService {
         QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool hasDeviceExtension(VkPhysicalDevice device, const char* name);
+        void setupTimestampCalibration();
 
         VkInstance instance;
         VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
         WindowService& windowService;
         VkCommandPool commandPool;
         VkCommandPool transferCommandPool;
+        VkCommandPool computeCommandPool;
+
+        bool indirectCountSupported = false;
+        bool dynamicRenderingSupported = false;
+        bool pipelineStatisticsSupported = false;
+        bool inheritedQueriesSupported = false;
+        bool memoryBudgetSupported = false;
+        bool bindlessSupported = false;
+        BindlessLimits bindlessLimits;
+        uint32_t timestampValidBits = 0;
+        float timestampPeriod_ = 0.0f;
+        bool calibratedTimestampsSupported = false;
+        VkTimeDomainEXT hostTimeDomain;
+        PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestampsEXT = nullptr;
 
         VkDevice device_;
-        VkSurfaceKHR surface_;
+        VkSurfaceKHR surface_ = VK_NULL_HANDLE;
+        bool headless = false;
         
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
@@ -80,6 +139,9 @@ class DeviceService {
 
         VmaAllocator allocator;
 
+        DeletionQueue deletionQueue{*this};
+        MemoryBudget memoryBudget{*this};
+        DescriptorAllocator descriptorAllocator{*this};
 
-        const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include "Mesh.h"
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct DrawItem {
+    const Mesh* mesh;
+    VkPipeline pipeline;
+    VkDescriptorSet descriptorSet;
+    glm::mat4 transform;
+    // Multiplies the vertex colors
+    glm::vec4 color;
+};
+
+// The frame packet handed to CommandService: every object drawn this frame
+class DrawList {
+public:
+    void add(const Mesh& mesh, VkPipeline pipeline, VkDescriptorSet descriptorSet, const glm::mat4& transform, const glm::vec4& color = glm::vec4(1.0f));
+    void clear();
+    void reserve(size_t count);
+
+    // Orders the items by pipeline, then descriptor set, then mesh so recording sees long runs of identical state.
+    // A run with the same mesh too is drawn as one instanced call.
+    void sort();
+
+    const std::vector<DrawItem>& getItems() const { return items; }
+    // Indices into getItems() in submission order (insertion order until sort() is called)
+    const std::vector<uint32_t>& getOrder() const { return order; }
+    size_t size() const { return items.size(); }
+
+    // Camera the list is drawn with, GPU culling builds its frustum from it
+    void setViewProjection(const glm::mat4& matrix) { viewProjection = matrix; }
+    const glm::mat4& getViewProjection() const { return viewProjection; }
+
+private:
+    struct SortKey {
+        uint64_t pipeline;
+        uint64_t descriptorSet;
+        uint64_t mesh;
+        uint32_t index;
+    };
+
+    std::vector<DrawItem> items;
+    std::vector<uint32_t> order;
+    std::vector<SortKey> keys;
+    glm::mat4 viewProjection{1.0f};
+};
\ No newline at end of file
@@ -5,53 +5,112 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "WindowService.h"
 #include "DeviceService.h"
+#include "FrameScheduler.h"
+#include "UploadService.h"
 #include "BufferService.h"
 #include "SwapChainService.h"
 #include "PipelineService.h"
+#include "CullingService.h"
 #include "CommandService.h"
+#include "DrawList.h"
+#include "FramePacer.h"
+#include "Tracer.h"
 
-struct UniformBufferObject {
-  alignas(16) glm::mat4 model;
-  alignas(16) glm::mat4 view;
-  alignas(16) glm::mat4 proj;
+// Picked per deployment: 1 frame in flight and few images for input-latency-critical kiosks, 3 for throughput
+struct EngineConfig {
+    uint32_t framesInFlight = CommandService::DEFAULT_FRAMES_IN_FLIGHT;
+    // 0 = minImageCount + 1
+    uint32_t swapChainImageCount = 0;
+    PresentPolicy presentPolicy = PresentPolicy::Vsync;
+    // Frame rate PresentPolicy::Capped holds
+    double fpsCap = 60.0;
+    // Frames to trace from startup (0 = none), F7 traces DEFAULT_TRACE_FRAMES at any time
+    uint32_t traceFrames = 0;
+    std::string tracePath = "aurelius_trace.json";
+    // No window or surface, frames go to offscreen targets (CI, benchmarks, lavapipe)
+    bool headless = false;
+    // Frames to render before run() returns, 0 = until the window closes (DEFAULT_HEADLESS_FRAMES when headless)
+    uint32_t frameCount = 0;
+    // CPU-recorded frames draw with the bindless pipeline variants (needs descriptor indexing)
+    bool bindless = false;
 };
 
 class Engine {
 public:
     static constexpr int WIDTH = 800;
     static constexpr int HEIGHT = 600;
+    // Seconds between pipeline cache saves while running
+    static constexpr double PIPELINE_CACHE_SAVE_INTERVAL = 60.0;
+    static constexpr uint32_t DEFAULT_TRACE_FRAMES = 120;
+    static constexpr uint32_t DEFAULT_HEADLESS_FRAMES = 1000;
+    // F8 writes VMA's detailed stats here
+    static constexpr const char* MEMORY_STATS_PATH = "aurelius_memory.json";
+
+    Engine(const EngineConfig& config = {}) : config(config) {}
 
     void run();
 
+    // Rebuilds the swapchain with the new present mode at the end of the current frame.
+    // Also bound to F1 - F5 (vsync, relaxed, mailbox, immediate, capped). F6 prints the GPU profile, F7 captures a trace,
+    // F8 prints GPU memory per heap and category plus the descriptor allocator's counters, and dumps the VMA stats.
+    void setPresentPolicy(PresentPolicy policy);
+
 private: 
+    // Declared first, the services below are built from it
+    EngineConfig config;
+    // Checked before any service is built, CullingService and CommandService both size their per-frame state by it
+    uint32_t framesInFlight = CommandService::checkFramesInFlight(config.framesInFlight);
 
     std::vector<VkBuffer> uniformBuffers;
     std::vector<VmaAllocation> uniformBuffersAllocations;
     std::vector<void*> uniformBuffersMapped;
 
     void createUniformBuffers();
-    void updateUniformBuffer(uint32_t currentImage);
+    // Rebuilds the camera matrices when they're dirty and writes them to the slots still holding the old ones.
+    // Per-object model matrices go through CommandService's object data instead.
+    void updateFrameConstants(uint32_t frameIndex, float time);
+
+    FrameConstants frameConstants{};
+    // The camera only changes with the swapchain extent for now
+    bool cameraDirty = true;
+    // Frame slots whose buffer still has matrices from before the last change
+    uint32_t staleFrameSlots = 0;
 
-    VkDescriptorPool descriptorPool;
-    std::vector<VkDescriptorSet> descriptorSets;
+    // Writes a slot's uniform buffer into a set, owned by the descriptor allocator
+    VkDescriptorUpdateTemplate frameConstantsTemplate;
 
-    void createDescriptorPool();
-    void createDescriptorSets();
+    void createDescriptorUpdateTemplate();
+    // Per-frame set for this frame's constants, gone once the slot's next waitForFrameSlot resets it
+    VkDescriptorSet allocateFrameDescriptorSet(uint32_t frameIndex);
 
     //Recreate swap chain on window resize
     void recreateSwapChain();
+    void handlePresentPolicyKeys();
+    bool presentPolicyChanged = false;
+    // Caps the frame rate for PresentPolicy::Capped, sleeping before input is sampled
+    FramePacer framePacer{config.presentPolicy == PresentPolicy::Capped ? config.fpsCap : 0.0};
     //Testing mesh
     Mesh squareMesh;
+    // Compiled in the background during startup, draws use the fallback until it is ready
+    PipelineHandle cubePipeline;
+    // Rebuilt every frame and handed to the CommandService
+    DrawList drawList;
     // Create the Window
-    WindowService windowService{WIDTH, HEIGHT, "AURELIUS ENGINE"};
+    WindowService windowService{WIDTH, HEIGHT, "AURELIUS ENGINE", config.headless};
     // Initialize Vulkan Device (needs Window)
     DeviceService deviceService{windowService};
-    // Create the BufferService(needs Device)
-    BufferService bufferService{deviceService};
+    // One timeline per queue, every submit is tracked by value (needs Device)
+    FrameScheduler frameScheduler{deviceService};
+    // Create the UploadService (needs Device + FrameScheduler)
+    UploadService uploadService{deviceService, frameScheduler};
+    // Create the BufferService(needs Device + Upload)
+    BufferService bufferService{deviceService, uploadService};
     // Create SwapChain (needs Device + Window)
-    SwapChainService swapChainService{deviceService, windowService};
+    SwapChainService swapChainService{deviceService, windowService, config.swapChainImageCount, config.presentPolicy};
     // Create Pipeline (needs Device + SwapChain)
     PipelineService pipelineService{deviceService, swapChainService};
+    // GPU culling for the indirect path (needs Device + Pipeline)
+    CullingService cullingService{deviceService, frameScheduler, pipelineService, framesInFlight};
     // Setup Commands & Drawing (needs Everything)
-    CommandService commandService{deviceService, swapChainService, pipelineService, bufferService};
+    CommandService commandService{deviceService, swapChainService, pipelineService, bufferService, uploadService, cullingService, frameScheduler, framesInFlight};
 };
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include <chrono>
+
+// CPU side frame limiter. pace() is called right before input is sampled, so the time a capped frame
+// would otherwise spend waiting after sampling (in the swapchain or on the GPU) is spent before it instead.
+class FramePacer {
+public:
+    // 0 = uncapped
+    FramePacer(double targetFps = 0.0);
+
+    void setTargetFps(double fps);
+    double getTargetFps() const { return targetFps; }
+
+    // Sleeps out whatever is left of the current frame's budget. A no-op when uncapped.
+    void pace();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // OS sleeps overshoot, so the last stretch is spun instead of slept
+    static constexpr std::chrono::microseconds SPIN_MARGIN{1000};
+
+    double targetFps = 0.0;
+    Clock::duration frameInterval{0};
+    Clock::time_point nextFrameStart;
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include "DeviceService.h"
+#include <vulkan/vulkan.h>
+#include <array>
+
+enum class QueueType : uint32_t {
+    Graphics = 0,
+    Compute,
+    Transfer,
+    Count
+};
+
+// One timeline semaphore per queue. Every submit signals the next value of its queue's timeline,
+// so "is this work done" is a plain integer compare and dependencies between queues are (timeline, value) waits.
+class FrameScheduler {
+public:
+    FrameScheduler(DeviceService& deviceService);
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    VkSemaphore getTimeline(QueueType queue) { return timelines[index(queue)].semaphore; }
+
+    // Value the next submit on this queue signals
+    uint64_t pendingValue(QueueType queue) { return timelines[index(queue)].nextValue; }
+    // Call right after a submit that signalled pendingValue(queue), returns that value
+    uint64_t markSubmitted(QueueType queue);
+    uint64_t lastSubmittedValue(QueueType queue) { return timelines[index(queue)].lastSubmitted; }
+
+    // Non-blocking: how far the GPU has got on this queue
+    uint64_t completedValue(QueueType queue);
+    bool isComplete(QueueType queue, uint64_t value);
+
+    // Blocks until the queue reaches value. Values never submitted return straight away.
+    void wait(QueueType queue, uint64_t value);
+    // Blocks until everything submitted so far on every queue has finished
+    void waitIdle();
+
+private:
+    struct Timeline {
+        VkSemaphore semaphore;
+        uint64_t nextValue = 1;
+        uint64_t lastSubmitted = 0;
+    };
+
+    static uint32_t index(QueueType queue) { return static_cast<uint32_t>(queue); }
+
+    DeviceService& deviceService;
+    std::array<Timeline, static_cast<size_t>(QueueType::Count)> timelines;
+};
\ No newline at end of file
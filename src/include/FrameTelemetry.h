@@ -0,0 +1,75 @@
+#pragma once
+#include "DeviceService.h"
+#include "FrameScheduler.h"
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <vector>
+
+// Latency numbers for one frame, in milliseconds
+struct FrameTiming {
+    // CPU submit until the frame's graphics work retired on the timeline. Not the actual present, which
+    // the compositor may hold back further. Retirement is noticed at the top of drawFrame, so it is exact when the CPU blocked on the frame
+    // and at most one CPU frame late otherwise.
+    double submitToRetire = 0.0;
+    // GPU gap between the end of the previous frame and the start of this one (GPU starved by the CPU)
+    double gpuIdle = 0.0;
+    // GPU start to end of the frame's command buffer
+    double gpuTime = 0.0;
+};
+
+// Per-frame-in-flight submit times and a begin/end timestamp pair, read back once the frame retired
+// so nothing ever waits on a query. Used to pick frames in flight and swapchain image count.
+class FrameTelemetry {
+public:
+    // Rolling window getAverage() covers
+    static constexpr uint32_t HISTORY_SIZE = 120;
+
+    FrameTelemetry(DeviceService& deviceService, FrameScheduler& frameScheduler, uint32_t framesInFlight);
+    ~FrameTelemetry();
+
+    FrameTelemetry(const FrameTelemetry&) = delete;
+    FrameTelemetry& operator=(const FrameTelemetry&) = delete;
+
+    // Outside any render pass, at the start and end of the frame's primary command buffer
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void endFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+    // Right after the submit that signalled timelineValue on the graphics timeline
+    void frameSubmitted(uint32_t frameIndex, uint64_t timelineValue);
+
+    // Picks up every frame that retired since the last call. Once per frame, after the frame slot wait.
+    void collect();
+
+    // False when the graphics queue can't write timestamps, gpuIdle and gpuTime stay 0 then
+    bool hasGpuTimestamps() const { return timestampsSupported; }
+
+    const FrameTiming& getLatest() const { return latest; }
+    FrameTiming getAverage() const;
+
+private:
+    struct FrameSlot {
+        uint64_t timelineValue = 0;
+        std::chrono::steady_clock::time_point submitTime;
+        bool pending = false;
+    };
+
+    void resolve(uint32_t frameIndex, std::chrono::steady_clock::time_point retireTime);
+
+    DeviceService& deviceService;
+    FrameScheduler& frameScheduler;
+
+    bool timestampsSupported = false;
+    // Nanoseconds per tick
+    double timestampPeriod = 1.0;
+    uint64_t timestampMask = ~0ull;
+    // Two queries per frame slot: [frame * 2] begin, [frame * 2 + 1] end
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+
+    std::vector<FrameSlot> slots;
+    // End timestamp of the last frame resolved, to measure the gap to the next one
+    uint64_t lastGpuEnd = 0;
+
+    FrameTiming latest;
+    std::vector<FrameTiming> history;
+    size_t historyNext = 0;
+};
\ No newline at end of file
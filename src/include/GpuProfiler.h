@@ -0,0 +1,120 @@
+#pragma once
+#include "DeviceService.h"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Counters of one VK_QUERY_TYPE_PIPELINE_STATISTICS query, in the order Vulkan writes them
+struct PipelineStatistics {
+    uint64_t inputAssemblyVertices = 0;
+    uint64_t inputAssemblyPrimitives = 0;
+    uint64_t vertexShaderInvocations = 0;
+    uint64_t clippingInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentShaderInvocations = 0;
+    uint64_t computeShaderInvocations = 0;
+};
+
+// Rolling numbers for one named scope, in milliseconds
+struct GpuScopeStats {
+    std::string name;
+    double minMs = 0.0;
+    double avgMs = 0.0;
+    double p99Ms = 0.0;
+    size_t samples = 0;
+    // Latest counters, only for scopes that had a statistics query
+    bool hasStatistics = false;
+    PipelineStatistics statistics;
+};
+
+// Named GPU scopes measured with timestamp and pipeline statistics queries. Every frame in flight has its
+// own query pools, and a slot is read back when it comes around again (framesInFlight frames late), by which
+// point the frame has retired and vkGetQueryPoolResults never waits.
+class GpuProfiler {
+public:
+    static constexpr uint32_t MAX_SCOPES_PER_FRAME = 32;
+    // Samples each scope's rolling min/avg/p99 covers
+    static constexpr size_t HISTORY_SIZE = 240;
+
+    GpuProfiler(DeviceService& deviceService, uint32_t framesInFlight);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Reads back what this slot measured last time round, then resets its queries.
+    // Start of the frame's primary command buffer, once the slot's previous submit has retired.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    // Right after the frame's submit, only submitted frames are read back
+    void frameSubmitted(uint32_t frameIndex);
+
+    // Scopes nest. name must be a string literal (the tracer keeps the pointer).
+    // Outermost scopes also get a pipeline statistics query, unless they execute secondaries on a
+    // device without inheritedQueries. Must begin and end on the same side of a render pass.
+    void beginScope(VkCommandBuffer commandBuffer, const char* name, bool executesSecondaries = false);
+    void endScope(VkCommandBuffer commandBuffer);
+
+    // Secondaries executed inside a statistics scope must be recorded with these in their inheritance info
+    VkQueryPipelineStatisticFlags getInheritedStatistics() const { return inheritedQueries ? STATISTICS_FLAGS : 0; }
+
+    bool hasTimestamps() const { return timestampsSupported; }
+    bool hasPipelineStatistics() const { return statisticsSupported; }
+
+    // Scopes in the order they were first seen
+    std::vector<GpuScopeStats> getScopeStats() const;
+    void printReport() const;
+
+private:
+    static constexpr VkQueryPipelineStatisticFlags STATISTICS_FLAGS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    struct Scope {
+        const char* name;
+        uint32_t timestampQuery;      // begin, end is + 1
+        uint32_t statisticsQuery;     // UINT32_MAX = none
+    };
+
+    struct FrameSlot {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+        std::vector<Scope> scopes;
+        // Indices into scopes of the ones still open
+        std::vector<uint32_t> openScopes;
+        uint32_t statisticsCount = 0;
+        bool submitted = false;
+    };
+
+    struct ScopeHistory {
+        std::vector<double> samples;
+        size_t next = 0;
+        bool hasStatistics = false;
+        PipelineStatistics statistics;
+    };
+
+    void readBack(FrameSlot& slot);
+    void record(const std::string& name, double milliseconds, const PipelineStatistics* statistics);
+
+    DeviceService& deviceService;
+
+    bool timestampsSupported = false;
+    bool statisticsSupported = false;
+    bool inheritedQueries = false;
+    // Nanoseconds per tick
+    double timestampPeriod = 1.0;
+    uint64_t timestampMask = ~0ull;
+
+    std::vector<FrameSlot> slots;
+    // Slot currently being recorded
+    FrameSlot* recording = nullptr;
+
+    std::unordered_map<std::string, ScopeHistory> history;
+    std::vector<std::string> scopeOrder;
+};
\ No newline at end of file
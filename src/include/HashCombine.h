@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+
+// boost::hash_combine, for the caches keyed by structs (pipeline descs, set layouts)
+inline void hashCombine(size_t& seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
\ No newline at end of file
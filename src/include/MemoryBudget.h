@@ -0,0 +1,65 @@
+#pragma once
+#include "vk_mem_alloc.h"
+#include <vulkan/vulkan.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class DeviceService;
+
+// What an allocation is for, so memory can be broken down by owner
+enum class MemoryCategory : uint32_t {
+    Mesh,           // Vertex and index arenas
+    Uniform,
+    Depth,
+    Staging,        // Staging ring and spill buffers
+    RenderTarget,   // Headless offscreen color targets
+    Culling,        // GPU-driven object, draw and count buffers
+    Other,
+    Count
+};
+
+const char* memoryCategoryName(MemoryCategory category);
+
+// Heap budgets (VK_EXT_memory_budget when the device has it, VMA's estimate otherwise) refreshed once a frame,
+// plus live bytes per MemoryCategory. Owned by DeviceService.
+class MemoryBudget {
+public:
+    // A heap whose usage passes this fraction of its budget prints a warning (once, until it drops back)
+    static constexpr double WARNING_FRACTION = 0.9;
+
+    MemoryBudget(DeviceService& deviceService);
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    // Right after vmaCreateBuffer / vmaCreateImage. Names the allocation after its category for the stats dump.
+    void track(VmaAllocation allocation, MemoryCategory category);
+    // Right before vmaDestroyBuffer / vmaDestroyImage, untracked allocations are ignored
+    void untrack(VmaAllocation allocation);
+
+    // Once per frame on the render thread: moves VMA's frame index on and refreshes the heap budgets
+    void update(uint32_t frameIndex);
+
+    // Per heap, as of the last update
+    const std::vector<VmaBudget>& getHeapBudgets() const { return heapBudgets; }
+    VkDeviceSize getCategoryBytes(MemoryCategory category) const;
+    // Usage over budget of the fullest heap
+    double getHighestHeapFraction() const;
+
+    // vmaBuildStatsString with the detailed map (JSON), false if the file can't be written
+    bool dumpStats(const std::string& path);
+    void printReport() const;
+
+private:
+    DeviceService& deviceService;
+
+    std::vector<VmaBudget> heapBudgets;
+    std::vector<VkMemoryHeapFlags> heapFlags;
+    std::vector<bool> heapWarned;
+
+    // Allocations can come and go off the render thread (upload batches retiring)
+    std::array<std::atomic<VkDeviceSize>, static_cast<size_t>(MemoryCategory::Count)> categoryBytes{};
+};
\ No newline at end of file
@@ -1,14 +1,17 @@
 #pragma once
-#include <vulkan/vulkan_core.h>
-#include "vk_mem_alloc.h"
-#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
 
+// A mesh is a slice of BufferService's shared vertex and index arenas.
+// Offsets are in elements, ready for vkCmdDrawIndexed's firstIndex / vertexOffset.
 struct Mesh {
-    VkBuffer vertexBuffer;
-    VmaAllocation vertexAllocation;
-
-    VkBuffer indexBuffer;
-    VmaAllocation indexAllocation;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
 
+    uint32_t firstIndex;
     uint32_t indexCount;
+
+    // Object space bounding sphere, used by GPU culling
+    glm::vec3 boundsCenter;
+    float boundsRadius;
 };
\ No newline at end of file
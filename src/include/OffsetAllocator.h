@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <optional>
+
+// Hands out [offset, offset + size) ranges of a fixed capacity. Units are up to the caller
+// (the mesh arenas count in vertices and indices). Best fit, neighbours merge on free.
+class OffsetAllocator {
+public:
+    OffsetAllocator(uint64_t capacity);
+
+    std::optional<uint64_t> allocate(uint64_t size);
+    void free(uint64_t offset, uint64_t size);
+
+    uint64_t getCapacity() const { return capacity; }
+    uint64_t getUsed() const { return used; }
+
+private:
+    void insertFreeBlock(uint64_t offset, uint64_t size);
+    void eraseFreeBlock(std::map<uint64_t, uint64_t>::iterator block);
+
+    uint64_t capacity;
+    uint64_t used = 0;
+
+    // offset -> size, for merging neighbours
+    std::map<uint64_t, uint64_t> freeByOffset;
+    // size -> offset, for best fit
+    std::multimap<uint64_t, uint64_t> freeBySize;
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <cstddef>
+
+struct SpecializationConstant {
+    VkShaderStageFlags stages;
+    uint32_t id;
+    uint32_t value;
+};
+
+// Everything that goes into a graphics pipeline. Two equal descs always share one VkPipeline.
+// The render pass is PipelineService's main pass, only the subpass and sample count are part of the key.
+struct PipelineDesc {
+    // Shaders
+    std::string vertPath;
+    std::string fragPath;
+    // Optional vertex shader for the GPU-driven path, empty if the pipeline has no indirect variant
+    std::string indirectVertPath;
+    // Optional vertex shader that reads its object data through the global bindless set, empty if none
+    std::string bindlessVertPath;
+    std::vector<SpecializationConstant> specializationConstants;
+
+    // Vertex layout (defaults to Vertex)
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    // Raster
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    // Depth
+    bool depthTest = true;
+    bool depthWrite = true;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+    // Blend (single color attachment)
+    bool blendEnable = false;
+    VkBlendFactor srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    VkBlendOp colorBlendOp = VK_BLEND_OP_ADD;
+    VkBlendFactor srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    VkBlendFactor dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    VkBlendOp alphaBlendOp = VK_BLEND_OP_ADD;
+    VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    // Render pass compatibility
+    uint32_t subpass = 0;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Opaque, depth tested, back face culled, standard Vertex layout
+    static PipelineDesc opaque(const std::string& vertPath, const std::string& fragPath, const std::string& indirectVertPath = "",
+        const std::string& bindlessVertPath = "");
+
+    bool operator==(const PipelineDesc& other) const;
+};
+
+struct PipelineDescHash {
+    size_t operator()(const PipelineDesc& desc) const;
+};
\ No newline at end of file
@@ -1,31 +1,138 @@
 #pragma once
 #include "DeviceService.h"
 #include "SwapChainService.h"
+#include "WorkerPool.h"
+#include "PipelineDesc.h"
 #include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <algorithm>
+#include <array>
+
+// Defined in BindlessRegistry.h
+enum class BindlessBinding : uint32_t;
+
+// Returned by requestPipeline straight away, the pipeline behind it may still be compiling
+struct PipelineHandle {
+    uint32_t index = UINT32_MAX;
+
+    bool isValid() const { return index != UINT32_MAX; }
+};
+
+// Set 0 of the pipeline layouts, mirrors FrameConstants in the vertex shaders (std140).
+// Written once per frame: the matrices only after the camera changed, time every frame.
+struct FrameConstants {
+    alignas(16) glm::mat4 view;
+    alignas(16) glm::mat4 proj;
+    alignas(16) glm::mat4 viewProj;
+    float time;
+};
+
+// Per-draw push constants of the main pipeline layout
+struct DrawConstants {
+    // Into the object storage buffer (set 1), of the draw's first instance
+    uint32_t objectIndex;
+};
 
 class PipelineService {
 public:
-    PipelineService(DeviceService& deviceService, SwapChainService& swapChainService);
+    static constexpr const char* DEFAULT_PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+    // Dynamic rendering is used when preferred and the device supports it, otherwise a render pass + framebuffers
+    PipelineService(DeviceService& deviceService, SwapChainService& swapChainService,
+        const std::string& pipelineCachePath = DEFAULT_PIPELINE_CACHE_PATH, bool preferDynamicRendering = true);
     ~PipelineService();
 
     PipelineService(const PipelineService&) = delete;
     PipelineService& operator=(const PipelineService&) = delete;
 
-    VkPipeline getPipeline() { return graphicsPipeline; }
+    // Handle 0 is built synchronously at startup and stands in for pipelines that are still compiling
+    static constexpr PipelineHandle DEFAULT_PIPELINE{0};
+
+    VkPipeline getPipeline() { return pipelineSlots[DEFAULT_PIPELINE.index].pipeline; }
     VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
+    // Set 1 of the pipeline layout, a STORAGE_BUFFER_DYNAMIC array of ObjectData the draws index into
+    VkDescriptorSetLayout getObjectDataSetLayout() { return objectDataSetLayout; }
+
+    // Looks the desc up in the registry. A new desc gets queued on the worker threads (against the
+    // shared pipeline cache), an identical one just gets the existing handle back. Never blocks.
+    PipelineHandle requestPipeline(const PipelineDesc& desc);
+    // Requests everything in the list and blocks until it is compiled, meant for loading screens
+    std::vector<PipelineHandle> prewarm(const std::vector<PipelineDesc>& descs);
+    // Blocks until every queued compile has finished
+    void waitForPipelines();
+
+    // Publishes finished compiles. Call once per frame on the render thread before building the draw list.
+    void pollPipelines();
+
+    // Plain index into the slot table, cheap enough for the draw path.
+    // VK_NULL_HANDLE while compiling (or if the compile failed), so the caller can skip the draw
+    VkPipeline getPipeline(PipelineHandle handle) { return pipelineSlots[handle.index].pipeline; }
+    // Same, but falls back to the startup pipeline
+    VkPipeline resolvePipeline(PipelineHandle handle);
+    bool isReady(PipelineHandle handle) { return pipelineSlots[handle.index].pipeline != VK_NULL_HANDLE; }
+
+    // GPU-driven path: the indirect variant of a pipeline reads its transform from the object buffer (set 1)
+    VkPipeline getIndirectVariant(VkPipeline pipeline);
+    VkPipelineLayout getIndirectPipelineLayout() { return indirectPipelineLayout; }
+    VkDescriptorSetLayout getObjectSetLayout() { return objectSetLayout; }
+
+    VkPipeline getCullPipeline() { return cullPipeline; }
+    VkPipelineLayout getCullPipelineLayout() { return cullPipelineLayout; }
+    VkDescriptorSetLayout getCullSetLayout() { return cullSetLayout; }
+
+    // Bindless path: the bindless variant reads its object data out of the global set (set 1), picked by push constants.
+    // All null when the device lacks descriptor indexing.
+    VkPipeline getBindlessVariant(VkPipeline pipeline);
+    VkPipelineLayout getBindlessPipelineLayout() { return bindlessPipelineLayout; }
+    VkDescriptorSetLayout getBindlessSetLayout() { return bindlessSetLayout; }
+    // Array size of a binding in the global set, the defaults below clamped to the device limits
+    uint32_t getBindlessCapacity(BindlessBinding binding) const;
+
+    static constexpr uint32_t DEFAULT_BINDLESS_STORAGE_BUFFERS = 16 * 1024;
+    static constexpr uint32_t DEFAULT_BINDLESS_SAMPLED_IMAGES = 16 * 1024;
+    static constexpr uint32_t DEFAULT_BINDLESS_SAMPLERS = 1024;
+
+    // With dynamic rendering there is no render pass and there are no framebuffers
+    bool isDynamicRendering() const { return dynamicRendering; }
     VkRenderPass getRenderPass() { return renderPass; }
-    
     VkFramebuffer getFramebuffer(int index) { return swapChainFramebuffers[index]; }
+
+    // Attachment formats the pipelines were built for
+    VkFormat getColorFormat() { return colorFormat; }
+    VkFormat getDepthFormat() { return depthFormat; }
     VkDescriptorSetLayout getDescriptorSetLayout() { return descriptorSetLayout; }
 
+    // Also rebuilds the render pass and pipelines when the swapchain came back with a different format.
+    // A no-op for plain resizes with dynamic rendering.
     void recreateFramebuffers();
 
+    // Writes the pipeline cache to disk (temp file + rename) if it grew since the last save
+    void savePipelineCache();
+
 private:
+    void createPipelineCache();
+    bool isPipelineCacheCompatible(const std::vector<char>& data);
     void createRenderPass();
+    void createPipelineLayouts();
     void createGraphicsPipeline();
+    void createCullPipeline();
     void createFramebuffers();
+    void submitCompile(uint32_t index);
+    void createBindlessSetLayout();
+    void destroyRequestedPipelines();
+
+    // Indirect and Bindless pick their own vertex shader (desc.indirectVertPath / bindlessVertPath) and layout
+    enum class PipelineVariant {
+        Standard,
+        Indirect,
+        Bindless
+    };
+    VkPipeline buildGraphicsPipeline(const PipelineDesc& desc, PipelineVariant variant);
 
     static std::vector<char> readFile(const std::string& filename);
     VkShaderModule createShaderModule(const std::vector<char>& code);
@@ -33,11 +140,59 @@ private:
     DeviceService& deviceService;
     SwapChainService& swapChainService;
 
-    VkRenderPass renderPass;
+    std::string pipelineCachePath;
+    VkPipelineCache pipelineCache;
+    // Seeded from disk, so creation should mostly hit the cache
+    bool pipelineCacheWarm = false;
+    size_t savedPipelineCacheSize = 0;
+
+    bool dynamicRendering;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFormat colorFormat;
+    VkFormat depthFormat;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    VkDescriptorSetLayout objectDataSetLayout;
+
+    VkDescriptorSetLayout objectSetLayout;
+    VkPipelineLayout indirectPipelineLayout;
+
+    VkDescriptorSetLayout bindlessSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout bindlessPipelineLayout = VK_NULL_HANDLE;
+    std::array<uint32_t, 3> bindlessCapacities{};
+
+    VkDescriptorSetLayout cullSetLayout;
+    VkPipelineLayout cullPipelineLayout;
+    VkPipeline cullPipeline;
+
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
+    // Only touched on the render thread, workers hand their results over through completedCompiles
+    struct PipelineSlot {
+        PipelineDesc desc;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipeline indirectPipeline = VK_NULL_HANDLE;
+        VkPipeline bindlessPipeline = VK_NULL_HANDLE;
+    };
+    struct CompileResult {
+        uint32_t index;
+        VkPipeline pipeline;
+        VkPipeline indirectPipeline;
+        VkPipeline bindlessPipeline;
+    };
+
+    std::vector<PipelineSlot> pipelineSlots;
+    std::unordered_map<PipelineDesc, uint32_t, PipelineDescHash> pipelineRegistry;
+    std::unordered_map<VkPipeline, VkPipeline> indirectVariants;
+    std::unordered_map<VkPipeline, VkPipeline> bindlessVariants;
+
+    std::mutex compileMutex;
+    std::condition_variable compileFinished;
+    std::vector<CompileResult> completedCompiles;
+    uint32_t pendingCompiles = 0;
+
+    // Compiles only; the destructor drains it before tearing down the render pass and layouts
+    WorkerPool compilePool{std::max(1u, WorkerPool::defaultWorkerCount() / 2)};
+
     VkDescriptorSetLayout descriptorSetLayout;
     void createDescriptorSetLayout();
 };
\ No newline at end of file
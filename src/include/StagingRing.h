@@ -0,0 +1,52 @@
+#pragma once
+#include "DeviceService.h"
+#include "UploadService.h"
+#include <vulkan/vulkan.h>
+#include <deque>
+
+// A mapped slice of staging memory. Write into mapped, copy from buffer at offset.
+struct StagingAllocation {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    void* mapped;
+};
+
+// Persistently mapped ring that every CPU -> GPU transfer is staged through.
+// Regions are tagged with the upload batch that reads them and reused once that batch retires.
+class StagingRing {
+public:
+    StagingRing(DeviceService& deviceService, UploadService& uploadService, VkDeviceSize size);
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // The region must be consumed by a copy recorded into the current upload batch.
+    // Requests bigger than the ring spill to a temporary buffer freed with that batch.
+    StagingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    VkDeviceSize getSize() { return size; }
+
+private:
+    struct Region {
+        VkDeviceSize offset;
+        VkDeviceSize end;
+        uint64_t timelineValue;
+    };
+
+    bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    void retireCompletedRegions();
+    StagingAllocation allocateSpill(VkDeviceSize size);
+
+    DeviceService& deviceService;
+    UploadService& uploadService;
+
+    VkDeviceSize size;
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    char* mapped;
+
+    // Next write position, live regions run from regions.front().offset up to head (wrapping)
+    VkDeviceSize head = 0;
+    std::deque<Region> regions;
+};
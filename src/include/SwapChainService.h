@@ -4,9 +4,26 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 
+enum class PresentPolicy {
+    Vsync,          // FIFO, always available
+    VsyncRelaxed,   // FIFO_RELAXED: a late frame tears instead of waiting a whole vblank
+    Mailbox,        // No tearing and low latency, but the GPU renders frames that are never shown
+    Immediate,      // Tears, lowest latency, runs as fast as the GPU goes
+    Capped          // Immediate with the FramePacer holding the frame rate
+};
+
+const char* presentPolicyName(PresentPolicy policy);
+
 class SwapChainService {
 public:
-    SwapChainService(DeviceService& deviceService, WindowService& windowService);
+    // Offscreen targets a headless window renders into round-robin. Must be at least
+    // CommandService::MAX_FRAMES_IN_FLIGHT, a target is only reused once the frame before it on that slot retired.
+    static constexpr uint32_t HEADLESS_IMAGE_COUNT = 3;
+
+    // imageCount 0 asks for minImageCount + 1, anything else is clamped to what the surface allows.
+    // With a headless window there is no swapchain: the images are VMA-allocated offscreen targets.
+    SwapChainService(DeviceService& deviceService, WindowService& windowService, uint32_t imageCount = 0,
+        PresentPolicy presentPolicy = PresentPolicy::Vsync);
     ~SwapChainService();
 
     SwapChainService(const SwapChainService&) = delete;
@@ -16,11 +33,27 @@ public:
     VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
     VkExtent2D getSwapChainExtent() { return swapChainExtent; }
     size_t getImageCount() { return swapChainImages.size(); }
+    // Takes effect on the next recreateSwapChain
+    void setRequestedImageCount(uint32_t imageCount) { requestedImageCount = imageCount; }
+    uint32_t getRequestedImageCount() { return requestedImageCount; }
+
+    // Present modes can't change on a live swapchain, so this also takes effect on the next recreateSwapChain.
+    // Unsupported modes fall back towards FIFO.
+    void setPresentPolicy(PresentPolicy policy) { presentPolicy = policy; }
+    PresentPolicy getPresentPolicy() { return presentPolicy; }
+    VkPresentModeKHR getPresentMode() { return presentMode; }
     VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+    VkImage getImage(int index) { return swapChainImages[index]; }
+
+    bool isHeadless() { return headless; }
+    // Layout the color target is left in at the end of the frame: PRESENT_SRC, or TRANSFER_SRC for offscreen readback
+    VkImageLayout getFinalLayout() { return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
 
-    // Check if the swap chain is compatible with the window
+    // Check if the swap chain is compatible with the window. Headless hands out the next target and signals nothing.
     VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
 
+    // Hands the old swapchain to the new one and retires the old images through the deletion queue,
+    // frames already in flight keep rendering into them
     void recreateSwapChain();
     void cleanupSwapChain();
 
@@ -28,16 +61,18 @@ public:
     VkFormat findDepthFormat();
 
     VkImageView getDepthImageView() { return depthImageView; }
+    VkImage getDepthImage() { return depthImage; }
 
 private:
-    void createSwapChain();
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
     void createImageViews();
+    void createOffscreenImages();
 
     VkImage depthImage;
     VmaAllocation depthImageAllocation;
     VkImageView depthImageView;
 
-    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage, VkImage& image, VmaAllocation& allocation);
+    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage, VkImage& image, VmaAllocation& allocation, MemoryCategory category);
 
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
@@ -46,8 +81,16 @@ private:
     DeviceService& deviceService;
     WindowService& windowService;
 
-    VkSwapchainKHR swapChain;
+    bool headless;
+    uint32_t requestedImageCount;
+    PresentPolicy presentPolicy;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
+    // Headless only, one per image
+    std::vector<VmaAllocation> offscreenAllocations;
+    uint32_t nextOffscreenImage = 0;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU frame tracer. Scopes are recorded into per-thread ring buffers (the owning thread is the only writer,
+// so recording takes no lock) and only while a capture is running. A capture covers N frames and is
+// written out as Chrome trace JSON, which chrome://tracing and ui.perfetto.dev both open.
+class Tracer {
+public:
+    // Events each thread keeps, older ones are overwritten
+    static constexpr size_t EVENTS_PER_THREAD = 64 * 1024;
+    // Oldest slots of each ring the dump leaves out, since scopes still open when the capture stopped may overwrite them meanwhile
+    static constexpr size_t DUMP_SLACK_EVENTS = 256;
+    // Frames the dump waits after the capture so the GPU scopes of its last frames have been read back
+    static constexpr uint32_t GPU_READBACK_FRAMES = 4;
+
+    static Tracer& get();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // Records the next frameCount frames and writes them to path
+    void startCapture(uint32_t frameCount, const std::string& path);
+    bool isCapturing() const { return capturing.load(std::memory_order_relaxed); }
+
+    // Main loop, once per frame
+    void endFrame();
+
+    // Shows up as the thread's name in the trace
+    void setThreadName(const std::string& name);
+
+    // name must outlive the capture (string literals)
+    void record(const char* name, uint64_t startNs, uint64_t endNs);
+    // A GPU scope already converted to steady_clock nanoseconds, shown on its own "GPU" track
+    void recordGpu(const char* name, uint64_t startNs, uint64_t endNs);
+
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+private:
+    Tracer() = default;
+
+    struct Event {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+
+    struct ThreadBuffer {
+        uint32_t threadId;
+        std::string name;
+        std::vector<Event> events = std::vector<Event>(EVENTS_PER_THREAD);
+        // Only the owning thread writes, the dump reads up to here
+        std::atomic<uint64_t> written{0};
+    };
+
+    ThreadBuffer& threadBuffer();
+    ThreadBuffer& registerThread(uint32_t threadId);
+    static void push(ThreadBuffer& buffer, const char* name, uint64_t startNs, uint64_t endNs);
+    void writeCapture();
+
+    std::atomic<bool> capturing{false};
+
+    // Registration and dumps only, never taken while recording
+    std::mutex buffersMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    ThreadBuffer* gpuBuffer = nullptr;
+
+    // Main thread only
+    std::string capturePath;
+    uint32_t framesLeft = 0;
+    uint32_t drainFramesLeft = 0;
+    uint64_t captureStartNs = 0;
+    uint64_t captureEndNs = 0;
+};
+
+// Records the enclosing block while a capture is running
+class TraceScope {
+public:
+    TraceScope(const char* name) : name(name), startNs(Tracer::get().isCapturing() ? Tracer::now() : 0) {}
+    ~TraceScope() {
+        if (startNs != 0) {
+            Tracer::get().record(name, startNs, Tracer::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t startNs;
+};
+
+#define AURELIUS_TRACE_CONCAT_INNER(a, b) a##b
+#define AURELIUS_TRACE_CONCAT(a, b) AURELIUS_TRACE_CONCAT_INNER(a, b)
+#define AURELIUS_TRACE(name) TraceScope AURELIUS_TRACE_CONCAT(traceScope, __LINE__)(name)
\ No newline at end of file
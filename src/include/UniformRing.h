@@ -0,0 +1,59 @@
+#pragma once
+#include "DeviceService.h"
+#include "vk_mem_alloc.h"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+// A mapped slice of this frame's region. offset is from the start of the buffer, ready to use as a dynamic offset.
+struct UniformAllocation {
+    VkDeviceSize offset;
+    void* mapped;
+};
+
+// One persistently mapped buffer split into a region per frame in flight. Per-frame shader data is
+// bump-allocated out of the frame's region at the device's uniform/storage offset alignment, so everything can
+// sit behind a single dynamic descriptor and nothing is allocated once the ring exists.
+class UniformRing {
+public:
+    // 200k objects of 80 bytes a frame
+    static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 16 * 1024 * 1024;
+
+    UniformRing(DeviceService& deviceService, uint32_t framesInFlight, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+    ~UniformRing();
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    // Frees the slot's region for reuse, once the slot's previous submit has retired
+    void beginFrame(uint32_t frameIndex);
+    // Render thread only. Throws when the frame's region is full.
+    // elementAlignment (a power of two) lines the start up relative to the frame's region, so it can be indexed from getFrameBase().
+    UniformAllocation allocate(VkDeviceSize size, VkDeviceSize elementAlignment = 1);
+    // Makes this frame's writes visible to the GPU, before the submit (a no-op on coherent memory)
+    void flush();
+
+    // size rounded up to the offset alignment, the stride of an array of dynamic-offset uniforms
+    VkDeviceSize alignedSize(VkDeviceSize size) const;
+
+    VkBuffer getBuffer() { return buffer; }
+    VkDeviceSize getFrameSize() const { return frameSize; }
+    // Start of a slot's region, for descriptors that cover one region for good
+    VkDeviceSize getFrameOffset(uint32_t frameIndex) const { return frameIndex * frameSize; }
+    // Start of the current frame's region, the dynamic offset of a descriptor covering the whole region
+    VkDeviceSize getFrameBase() const { return frameBase; }
+    // Bytes handed out this frame
+    VkDeviceSize getUsed() const { return head - frameBase; }
+
+private:
+    DeviceService& deviceService;
+
+    VkDeviceSize frameSize;
+    VkDeviceSize alignment;
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    char* mapped;
+
+    // Current frame's region runs from frameBase to frameBase + frameSize
+    VkDeviceSize frameBase = 0;
+    VkDeviceSize head = 0;
+};
\ No newline at end of file
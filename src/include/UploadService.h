@@ -0,0 +1,72 @@
+#pragma once
+#include "DeviceService.h"
+#include "FrameScheduler.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <utility>
+
+// Handed back for every upload. It completes once the transfer timeline reaches value.
+struct UploadTicket {
+    uint64_t value = 0;
+};
+
+class UploadService {
+public:
+    UploadService(DeviceService& deviceService, FrameScheduler& frameScheduler);
+    ~UploadService();
+
+    UploadService(const UploadService&) = delete;
+    UploadService& operator=(const UploadService&) = delete;
+
+    // Records a copy into the open batch. Nothing reaches the GPU until flush()
+    // Concurrent destinations are shared by both families and skip the ownership transfer.
+    UploadTicket enqueueCopy(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region, VkSharingMode dstSharingMode = VK_SHARING_MODE_EXCLUSIVE);
+
+    // Keeps a staging buffer alive until the open batch has been consumed by the GPU
+    void releaseAfterUpload(VkBuffer buffer, VmaAllocation allocation);
+
+    // Submits the open batch to the transfer queue and returns without waiting
+    UploadTicket flush();
+
+    // Ticket of the batch the next enqueueCopy lands in
+    UploadTicket pendingTicket() { return {frameScheduler.pendingValue(QueueType::Transfer)}; }
+
+    bool isComplete(UploadTicket ticket);
+    void wait(UploadTicket ticket);
+
+    // Records the queue family acquire barriers of every submitted batch into a graphics command buffer.
+    // Returns the transfer timeline value that submit has to wait on, or 0 if there is nothing new.
+    uint64_t recordAcquireBarriers(VkCommandBuffer commandBuffer);
+
+    VkSemaphore getTimelineSemaphore() { return frameScheduler.getTimeline(QueueType::Transfer); }
+
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t timelineValue = 0;
+        std::vector<VkBufferMemoryBarrier> ownershipBarriers;
+        std::vector<std::pair<VkBuffer, VmaAllocation>> stagingBuffers;
+    };
+
+    void beginBatch();
+    void collectCompletedBatches();
+
+    DeviceService& deviceService;
+    FrameScheduler& frameScheduler;
+
+    uint32_t graphicsFamily;
+    uint32_t transferFamily;
+
+    Batch openBatch;
+    bool batchOpen = false;
+
+    // Transfer timeline value graphics last took ownership up to
+    uint64_t lastAcquiredValue = 0;
+
+    std::deque<Batch> inFlightBatches;
+    std::vector<VkCommandBuffer> freeCommandBuffers;
+
+    // Graphics side half of the ownership transfers, recorded into the next frame
+    std::vector<VkBufferMemoryBarrier> pendingAcquireBarriers;
+};
@@ -2,20 +2,28 @@
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
 #include <string>
+#include <vector>
 
 class WindowService {
     public:
-        WindowService(int width, int height, std::string name);
+        // Headless keeps the size for the offscreen target but never touches GLFW
+        WindowService(int width, int height, std::string name, bool headless = false);
         ~WindowService();
 
         WindowService(const WindowService&) = delete;
         WindowService& operator=(const WindowService&) = delete;
 
-        bool shouldClose() {return glfwWindowShouldClose(window); };
+        bool shouldClose() { return !headless && glfwWindowShouldClose(window); };
+        bool isHeadless() const { return headless; }
 
         bool wasWindowResized() { return framebufferResized; }
         void resetWindowResizedFlag() { framebufferResized = false; }
 
+        // glfwPollEvents, dropping key presses nobody asked about since the last call
+        void pollEvents();
+        // True once per press picked up by the last pollEvents
+        bool wasKeyPressed(int key);
+
         VkExtent2D getExtent() { return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)}; };
 
         void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
@@ -28,9 +36,13 @@ private:
 
         bool framebufferResized = false;
         static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+        static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+        std::vector<int> pressedKeys;
 
         int width;
         int height;
         std::string windowName;
-        GLFWwindow* window;
+        bool headless;
+        GLFWwindow* window = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs off one queue
+class WorkerPool {
+public:
+    WorkerPool(uint32_t workerCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    // Queues a job and returns immediately
+    void submit(std::function<void()> job);
+
+    // Runs job(0) .. job(jobCount - 1) across the workers and blocks until all of them are done.
+    // The first exception thrown by a job is rethrown here.
+    void parallelFor(uint32_t jobCount, const std::function<void(uint32_t jobIndex)>& job);
+
+    // One worker per core, leaving one for the main thread
+    static uint32_t defaultWorkerCount();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping = false;
+};
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "../include/BindlessRegistry.h"
+#include <algorithm>
+#include <stdexcept>
+
+BindlessRegistry::BindlessRegistry(DeviceService& device, PipelineService& pipelineService) : deviceService(device) {
+    VkDescriptorSetLayout setLayout = pipelineService.getBindlessSetLayout();
+    if (setLayout == VK_NULL_HANDLE) {
+        return;
+    }
+
+    for (size_t i = 0; i < tables.size(); i++) {
+        tables[i].capacity = pipelineService.getBindlessCapacity(static_cast<BindlessBinding>(i));
+    }
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, getCapacity(BindlessBinding::StorageBuffers)};
+    poolSizes[1] = {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, getCapacity(BindlessBinding::SampledImages)};
+    poolSizes[2] = {VK_DESCRIPTOR_TYPE_SAMPLER, getCapacity(BindlessBinding::Samplers)};
+
+    // Sets from an update-after-bind layout have to come from an update-after-bind pool
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(deviceService.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create bindless descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &setLayout;
+
+    if (vkAllocateDescriptorSets(deviceService.device(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate bindless descriptor set!");
+    }
+}
+
+BindlessRegistry::~BindlessRegistry() {
+    // The owner has drained the graphics queue by now, destroying the pool frees the set
+    if (descriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(deviceService.device(), descriptorPool, nullptr);
+    }
+}
+
+uint32_t BindlessRegistry::registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t slot = allocateSlot(BindlessBinding::StorageBuffers);
+    VkDescriptorBufferInfo bufferInfo{buffer, offset, range};
+    writeDescriptor(BindlessBinding::StorageBuffers, slot, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfo, nullptr);
+    return slot;
+}
+
+uint32_t BindlessRegistry::registerSampledImage(VkImageView imageView, VkImageLayout layout) {
+    uint32_t slot = allocateSlot(BindlessBinding::SampledImages);
+    VkDescriptorImageInfo imageInfo{VK_NULL_HANDLE, imageView, layout};
+    writeDescriptor(BindlessBinding::SampledImages, slot, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, nullptr, &imageInfo);
+    return slot;
+}
+
+uint32_t BindlessRegistry::registerSampler(VkSampler sampler) {
+    uint32_t slot = allocateSlot(BindlessBinding::Samplers);
+    VkDescriptorImageInfo imageInfo{sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+    writeDescriptor(BindlessBinding::Samplers, slot, VK_DESCRIPTOR_TYPE_SAMPLER, nullptr, &imageInfo);
+    return slot;
+}
+
+void BindlessRegistry::release(BindlessBinding binding, uint32_t slot) {
+    if (slot == INVALID_SLOT) {
+        return;
+    }
+    // The stale descriptor stays behind, partially bound means nothing minds as long as no shader reads it
+    pendingReleases.push_back({deviceService.getDeletionQueue().getRetireValue(), binding, slot});
+}
+
+void BindlessRegistry::collect(uint64_t completedValue) {
+    auto retired = std::partition(pendingReleases.begin(), pendingReleases.end(),
+        [completedValue](const PendingRelease& release) { return release.retireValue > completedValue; });
+
+    for (auto it = retired; it != pendingReleases.end(); ++it) {
+        tables[static_cast<size_t>(it->binding)].freeSlots.push_back(it->slot);
+    }
+    pendingReleases.erase(retired, pendingReleases.end());
+}
+
+uint32_t BindlessRegistry::getUsed(BindlessBinding binding) const {
+    const SlotTable& table = tables[static_cast<size_t>(binding)];
+    uint32_t pending = 0;
+    for (const PendingRelease& release : pendingReleases) {
+        pending += release.binding == binding ? 1 : 0;
+    }
+    return table.highWater - static_cast<uint32_t>(table.freeSlots.size()) - pending;
+}
+
+uint32_t BindlessRegistry::allocateSlot(BindlessBinding binding) {
+    if (!isSupported()) {
+        throw std::runtime_error("Bindless resources are not supported on this device!");
+    }
+
+    SlotTable& table = tables[static_cast<size_t>(binding)];
+    if (!table.freeSlots.empty()) {
+        uint32_t slot = table.freeSlots.back();
+        table.freeSlots.pop_back();
+        return slot;
+    }
+
+    if (table.highWater >= table.capacity) {
+        throw std::runtime_error("Bindless descriptor array is full!");
+    }
+    return table.highWater++;
+}
+
+void BindlessRegistry::writeDescriptor(BindlessBinding binding, uint32_t slot, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo) {
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = static_cast<uint32_t>(binding);
+    write.dstArrayElement = slot;
+    write.descriptorType = type;
+    write.descriptorCount = 1;
+    write.pBufferInfo = bufferInfo;
+    write.pImageInfo = imageInfo;
+
+    vkUpdateDescriptorSets(deviceService.device(), 1, &write, 0, nullptr);
+}
\ No newline at end of file
@@ -1,63 +1,129 @@
 #include "../include/BufferService.h"
+#include "../include/Tracer.h"
 #include <stdexcept>
 #include <cstring>
+#include <limits>
+#include <algorithm>
 
 
-BufferService::BufferService(DeviceService& device) : deviceService(device) {
+BufferService::BufferService(DeviceService& device, UploadService& upload, VkDeviceSize stagingRingSize, uint32_t vertexArenaCapacity, uint32_t indexArenaCapacity)
+    : deviceService(device), uploadService(upload), stagingRing(device, upload, stagingRingSize),
+      vertexArena(vertexArenaCapacity), indexArena(indexArenaCapacity) {
+    createVertexBuffer();
+    createIndexBuffer();
 }
 
 BufferService::~BufferService() {
+    // Uploads into the arenas may still be in flight
+    uploadService.wait(uploadService.flush());
+    // Deferred mesh frees point into our arenas. Everything that draws from them is already torn down.
+    deviceService.getDeletionQueue().flush();
+
+    deviceService.getMemoryBudget().untrack(indexBufferAllocation);
+    vmaDestroyBuffer(deviceService.getAllocator(), indexBuffer, indexBufferAllocation);
+    deviceService.getMemoryBudget().untrack(vertexBufferAllocation);
+    vmaDestroyBuffer(deviceService.getAllocator(), vertexBuffer, vertexBufferAllocation);
+}
 
+void BufferService::createVertexBuffer() {
+    createArenaBuffer(vertexArena.getCapacity() * sizeof(Vertex), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferAllocation);
 }
 
-Mesh BufferService::uploadMesh(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices) {
-    Mesh mesh{};
-    mesh.indexCount = static_cast<uint32_t>(indices.size());
+void BufferService::createIndexBuffer() {
+    createArenaBuffer(indexArena.getCapacity() * sizeof(uint16_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferAllocation);
+}
+
+void BufferService::createArenaBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VmaAllocation& allocation) {
+    QueueFamilyIndices indices = deviceService.findPhysicalQueueFamilies();
+    uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.transferFamily.value()};
 
-    // --- Vertex Buffer ---
-    VkDeviceSize vertexSize = sizeof(vertices[0]) * vertices.size();
-    
-    VkBuffer stagingBuffer;
-    VmaAllocation stagingAlloc;
-    
-    // 1. Staging
-    createBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer, stagingAlloc);
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
 
-    void* data;
-    vmaMapMemory(deviceService.getAllocator(), stagingAlloc, &data);
-    memcpy(data, vertices.data(), (size_t)vertexSize);
-    vmaUnmapMemory(deviceService.getAllocator(), stagingAlloc);
+    // The transfer queue writes new meshes while graphics reads the old ones from the same buffer,
+    // so ownership can't be bounced per upload
+    if (indices.graphicsFamily != indices.transferFamily) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+    } else {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+    arenaSharingMode = bufferInfo.sharingMode;
 
-    // 2. GPU Buffer
-    createBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, mesh.vertexBuffer, mesh.vertexAllocation);
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-    // 3. Copy
-    deviceService.copyBuffer(stagingBuffer, mesh.vertexBuffer, vertexSize);
-    vmaDestroyBuffer(deviceService.getAllocator(), stagingBuffer, stagingAlloc);
+    if (vmaCreateBuffer(deviceService.getAllocator(), &bufferInfo, &allocInfo, &buffer, &allocation, nullptr) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create mesh arena buffer!");
+    }
+    deviceService.getMemoryBudget().track(allocation, MemoryCategory::Mesh);
+}
 
-    // --- Index Buffer ---
-    VkDeviceSize indexSize = sizeof(indices[0]) * indices.size();
+Mesh BufferService::uploadMesh(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices) {
+    AURELIUS_TRACE("BufferService::uploadMesh");
+    Mesh mesh{};
+    mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+    mesh.indexCount = static_cast<uint32_t>(indices.size());
 
-    createBuffer(indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, stagingBuffer, stagingAlloc);
+    // --- Bounds ---
+    glm::vec3 minimum(std::numeric_limits<float>::max());
+    glm::vec3 maximum(std::numeric_limits<float>::lowest());
+    for (const Vertex& vertex : vertices) {
+        minimum = glm::min(minimum, vertex.pos);
+        maximum = glm::max(maximum, vertex.pos);
+    }
+    mesh.boundsCenter = (minimum + maximum) * 0.5f;
+    mesh.boundsRadius = 0.0f;
+    for (const Vertex& vertex : vertices) {
+        mesh.boundsRadius = std::max(mesh.boundsRadius, glm::length(vertex.pos - mesh.boundsCenter));
+    }
 
-    vmaMapMemory(deviceService.getAllocator(), stagingAlloc, &data);
-    memcpy(data, indices.data(), (size_t)indexSize);
-    vmaUnmapMemory(deviceService.getAllocator(), stagingAlloc);
+    // --- Vertex Range ---
+    std::optional<uint64_t> vertexOffset = vertexArena.allocate(mesh.vertexCount);
+    if (!vertexOffset) {
+        throw std::runtime_error("Vertex arena is out of space!");
+    }
+    mesh.vertexOffset = static_cast<int32_t>(*vertexOffset);
 
-    createBuffer(indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, mesh.indexBuffer, mesh.indexAllocation);
+    // --- Index Range ---
+    std::optional<uint64_t> firstIndex = indexArena.allocate(mesh.indexCount);
+    if (!firstIndex) {
+        vertexArena.free(*vertexOffset, mesh.vertexCount);
+        throw std::runtime_error("Index arena is out of space!");
+    }
+    mesh.firstIndex = static_cast<uint32_t>(*firstIndex);
 
-    deviceService.copyBuffer(stagingBuffer, mesh.indexBuffer, indexSize);
-    vmaDestroyBuffer(deviceService.getAllocator(), stagingBuffer, stagingAlloc);
+    uploadToBuffer(vertexBuffer, *vertexOffset * sizeof(Vertex), vertices.data(), sizeof(vertices[0]) * vertices.size(), arenaSharingMode);
+    uploadToBuffer(indexBuffer, *firstIndex * sizeof(uint16_t), indices.data(), sizeof(indices[0]) * indices.size(), arenaSharingMode);
 
     return mesh;
 }
 
+UploadTicket BufferService::uploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, VkSharingMode dstSharingMode) {
+    // 1. Stage (persistently mapped ring, no allocation unless the upload outgrows it)
+    StagingAllocation staging = stagingRing.allocate(size);
+    memcpy(staging.mapped, data, (size_t)size);
+
+    // 2. Copy (batched, the region is recycled once the transfer retires)
+    VkBufferCopy region{};
+    region.srcOffset = staging.offset;
+    region.dstOffset = dstOffset;
+    region.size = size;
+    return uploadService.enqueueCopy(staging.buffer, dstBuffer, region, dstSharingMode);
+}
+
 void BufferService::destroyMesh(const Mesh& mesh) {
-    vmaDestroyBuffer(deviceService.getAllocator(), mesh.indexBuffer, mesh.indexAllocation);
-    vmaDestroyBuffer(deviceService.getAllocator(), mesh.vertexBuffer, mesh.vertexAllocation);
+    // Frames in flight may still draw from these ranges, so they only go back to the arenas once those retire
+    deviceService.getDeletionQueue().push([this, mesh]() {
+        indexArena.free(mesh.firstIndex, mesh.indexCount);
+        vertexArena.free(static_cast<uint64_t>(mesh.vertexOffset), mesh.vertexCount);
+    });
 }
 
-void BufferService::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation) {
+void BufferService::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation, MemoryCategory category) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -70,4 +136,5 @@ void BufferService::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Vm
     if (vmaCreateBuffer(deviceService.getAllocator(), &bufferInfo, &allocInfo, &buffer, &allocation, nullptr) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create buffer using VMA!");
     }
+    deviceService.getMemoryBudget().track(allocation, category);
 }
\ No newline at end of file
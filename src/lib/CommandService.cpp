@@ -1,13 +1,28 @@
 #include "../include/CommandService.h"
+#include "../include/Tracer.h"
 #include <stdexcept>
 #include <iostream>
-
-CommandService::CommandService(DeviceService &device, SwapChainService &swapChain, PipelineService &pipeline, BufferService &buffer)
-    : deviceService(device), swapChainService(swapChain), pipelineService(pipeline), bufferService(buffer)
+#include <algorithm>
+#include <string>
+
+CommandService::CommandService(DeviceService &device, SwapChainService &swapChain, PipelineService &pipeline, BufferService &buffer, UploadService &upload, CullingService &culling, FrameScheduler &scheduler,
+    uint32_t frames)
+    : deviceService(device), swapChainService(swapChain), pipelineService(pipeline), bufferService(buffer), uploadService(upload), cullingService(culling), frameScheduler(scheduler),
+      framesInFlight(checkFramesInFlight(frames)), telemetry(device, scheduler, framesInFlight), profiler(device, framesInFlight),
+      uniformRing(device, framesInFlight), bindlessRegistry(device, pipeline)
 {
+    if (bindlessRegistry.isSupported())
+    {
+        for (uint32_t i = 0; i < framesInFlight; i++)
+        {
+            objectBufferSlots.push_back(bindlessRegistry.registerStorageBuffer(uniformRing.getBuffer(), uniformRing.getFrameOffset(i), uniformRing.getFrameSize()));
+        }
+    }
 
     createCommandBuffers();
     createSyncObjects();
+    createWorkerCommandPools();
+    createObjectDataSet();
 }
 
 CommandService::~CommandService()
@@ -15,17 +30,31 @@ CommandService::~CommandService()
     // Wait for GPU to finish before destroying sync
     vkDeviceWaitIdle(deviceService.device());
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (size_t i = 0; i < framesInFlight; i++)
     {
         vkDestroySemaphore(deviceService.device(), renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(deviceService.device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(deviceService.device(), inFlightFences[i], nullptr);
+    }
+
+    // Destroying the pools frees their secondary command buffers too
+    for (auto pool : workerCommandPools)
+    {
+        vkDestroyCommandPool(deviceService.device(), pool, nullptr);
     }
 }
 
+uint32_t CommandService::checkFramesInFlight(uint32_t framesInFlight)
+{
+    if (framesInFlight < 1 || framesInFlight > MAX_FRAMES_IN_FLIGHT)
+    {
+        throw std::runtime_error("Frames in flight must be between 1 and " + std::to_string(MAX_FRAMES_IN_FLIGHT) + "!");
+    }
+    return framesInFlight;
+}
+
 void CommandService::createCommandBuffers()
 {
-    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    commandBuffers.resize(framesInFlight);
 
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -39,31 +68,116 @@ void CommandService::createCommandBuffers()
     }
 }
 
+void CommandService::createWorkerCommandPools()
+{
+    uint32_t workerCount = workerPool.getWorkerCount();
+    workerCommandPools.resize(framesInFlight * workerCount);
+    workerCommandBuffers.resize(framesInFlight * workerCount);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // Reset as a whole every frame, never per buffer
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = deviceService.findPhysicalQueueFamilies().graphicsFamily.value();
+
+    for (size_t i = 0; i < workerCommandPools.size(); i++)
+    {
+        if (vkCreateCommandPool(deviceService.device(), &poolInfo, nullptr, &workerCommandPools[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create worker command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = workerCommandPools[i];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(deviceService.device(), &allocInfo, &workerCommandBuffers[i]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate secondary command buffers!");
+        }
+    }
+}
+
+void CommandService::createObjectDataSet() {
+    DescriptorAllocator& descriptorAllocator = deviceService.getDescriptorAllocator();
+    VkDescriptorSetLayout layout = pipelineService.getObjectDataSetLayout();
+
+    VkDescriptorUpdateTemplateEntry entry{};
+    entry.dstBinding = 0;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = 1;
+    entry.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    entry.offset = 0;
+    entry.stride = sizeof(VkDescriptorBufferInfo);
+    VkDescriptorUpdateTemplate updateTemplate = descriptorAllocator.createUpdateTemplate(layout, {entry});
+
+    objectDataSet = descriptorAllocator.allocate(layout);
+
+    // The range is one frame's region, the dynamic offset picks which frame
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = uniformRing.getBuffer();
+    bufferInfo.offset = 0;
+    bufferInfo.range = uniformRing.getFrameSize();
+
+    descriptorAllocator.update(objectDataSet, updateTemplate, &bufferInfo);
+}
+
+void CommandService::writeObjectData(const DrawList& drawList) {
+    AURELIUS_TRACE("Write object data");
+
+    const std::vector<DrawItem>& items = drawList.getItems();
+    const std::vector<uint32_t>& order = drawList.getOrder();
+
+    // The slot's previous submit has retired, so its whole region is free again
+    uniformRing.beginFrame(currentFrame);
+
+    // First allocation of the region, so object i is element i of both the object set and the bindless view of the region
+    UniformAllocation allocation = uniformRing.allocate(drawList.size() * sizeof(ObjectData));
+    objectDataOffset = static_cast<uint32_t>(uniformRing.getFrameBase());
+
+    ObjectData* objects = static_cast<ObjectData*>(allocation.mapped);
+    for (size_t i = 0; i < order.size(); i++) {
+        const DrawItem& item = items[order[i]];
+        objects[i].model = item.transform;
+        objects[i].color = item.color;
+    }
+
+    uniformRing.flush();
+    drawCalls.store(0, std::memory_order_relaxed);
+}
+
 void CommandService::createSyncObjects()
 {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderFinishedSemaphores.resize(framesInFlight);
+    frameTimelineValues.assign(framesInFlight, 0);
+    descriptorResetValues.assign(framesInFlight, 0);
 
+    // The swapchain only takes binary semaphores, everything else goes through the FrameScheduler timelines
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (size_t i = 0; i < framesInFlight; i++)
     {
         if (vkCreateSemaphore(deviceService.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(deviceService.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(deviceService.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+            vkCreateSemaphore(deviceService.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to create synchronization objects!");
         }
     }
 }
 
-void CommandService::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, const Mesh& mesh, VkDescriptorSet descriptorSet) {
+void CommandService::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, DrawList& drawList) {
+    AURELIUS_TRACE("CommandService::recordCommandBuffer");
+
+    // drawFrame already sorted the list when it tried the culling pass
+    if (!listSorted) {
+        drawList.sort();
+    }
+    listSorted = false;
+
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -71,64 +185,444 @@ void CommandService::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
         throw std::runtime_error("Failed to begin recording command buffer!");
     }
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = pipelineService.getRenderPass();
-    renderPassInfo.framebuffer = pipelineService.getFramebuffer(imageIndex);
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapChainService.getSwapChainExtent();
+    telemetry.beginFrame(commandBuffer, currentFrame);
+    profiler.beginFrame(commandBuffer, currentFrame);
+
+    // Take ownership of everything the transfer queue finished uploading (must be outside the render pass)
+    profiler.beginScope(commandBuffer, "Upload acquire");
+    uploadWaitValue = uploadService.recordAcquireBarriers(commandBuffer);
+    profiler.endScope(commandBuffer);
+
+    // Written up front, so recording (possibly on the workers) only has to push indices
+    if (cullWaitValue == 0) {
+        writeObjectData(drawList);
+    }
+    bindlessFrame = cullWaitValue == 0 && bindlessRendering && bindlessRegistry.isSupported() && hasBindlessVariants(drawList);
+
+    uint32_t chunkCount = getChunkCount(drawList);
+
+    profiler.beginScope(commandBuffer, cullWaitValue != 0 ? "Main pass (GPU)" : "Main pass", chunkCount > 1 && cullWaitValue == 0);
+
+    if (cullWaitValue != 0) {
+        beginRendering(commandBuffer, imageIndex, false);
+
+            recordFrameState(commandBuffer);
+            recordIndirectDraws(commandBuffer);
+
+        endRendering(commandBuffer, imageIndex);
+    } else if (chunkCount > 1) {
+        beginRendering(commandBuffer, imageIndex, true);
+
+            recordSecondaryCommandBuffers(imageIndex, drawList, chunkCount);
+
+            VkCommandBuffer* secondaries = &workerCommandBuffers[currentFrame * workerPool.getWorkerCount()];
+            vkCmdExecuteCommands(commandBuffer, chunkCount, secondaries);
+
+        endRendering(commandBuffer, imageIndex);
+    } else {
+        beginRendering(commandBuffer, imageIndex, false);
+
+            recordFrameState(commandBuffer);
+            recordDraws(commandBuffer, drawList, 0, drawList.size());
+
+        endRendering(commandBuffer, imageIndex);
+    }
+
+    profiler.endScope(commandBuffer);
 
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-    clearValues[1].depthStencil = {1.0f, 0}; // Clear depth to 1.0 (farthest)
+    telemetry.endFrame(commandBuffer, currentFrame);
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record command buffer!");
+    }
+}
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+void CommandService::recordDrawsOnly(VkCommandBuffer commandBuffer, uint32_t imageIndex, DrawList& drawList) {
+    AURELIUS_TRACE("CommandService::recordDrawsOnly");
 
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineService.getPipeline());
+    drawList.sort();
 
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapChainService.getSwapChainExtent().width;
-        viewport.height = (float)swapChainService.getSwapChainExtent().height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainService.getSwapChainExtent();
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-        // -----------------------------------------------------------------
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin recording command buffer!");
+    }
+
+    // Same draws and binds a real frame would record, the object indices just point at whatever the ring holds
+    bindlessFrame = bindlessRendering && bindlessRegistry.isSupported() && hasBindlessVariants(drawList);
+    drawCalls.store(0, std::memory_order_relaxed);
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineService.getPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr);
+    uint32_t chunkCount = getChunkCount(drawList);
+    if (chunkCount > 1) {
+        beginRendering(commandBuffer, imageIndex, true);
 
-        VkBuffer vertexBuffers[] = {mesh.vertexBuffer}; 
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+            recordSecondaryCommandBuffers(imageIndex, drawList, chunkCount);
 
-        vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+            VkCommandBuffer* secondaries = &workerCommandBuffers[currentFrame * workerPool.getWorkerCount()];
+            vkCmdExecuteCommands(commandBuffer, chunkCount, secondaries);
 
-        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0); 
+        endRendering(commandBuffer, imageIndex);
+    } else {
+        beginRendering(commandBuffer, imageIndex, false);
 
-    vkCmdEndRenderPass(commandBuffer);
+            recordFrameState(commandBuffer);
+            recordDraws(commandBuffer, drawList, 0, drawList.size());
+
+        endRendering(commandBuffer, imageIndex);
+    }
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("Failed to record command buffer!");
     }
 }
 
-VkResult CommandService::drawFrame(const Mesh& mesh, VkDescriptorSet descriptorSet) {
-    vkWaitForFences(deviceService.device(), 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+uint32_t CommandService::getChunkCount(const DrawList& drawList) {
+    // Only worth going wide when every worker gets a meaningful share
+    if (!parallelRecording) {
+        return 1;
+    }
+    size_t wanted = drawList.size() / MIN_DRAWS_PER_WORKER;
+    return static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(wanted, workerPool.getWorkerCount())));
+}
+
+void CommandService::beginRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool secondaries) {
+    VkClearValue colorClear{};
+    colorClear.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    VkClearValue depthClear{};
+    depthClear.depthStencil = {1.0f, 0}; // Clear depth to 1.0 (farthest)
+
+    VkRect2D renderArea{};
+    renderArea.offset = {0, 0};
+    renderArea.extent = swapChainService.getSwapChainExtent();
+
+    if (!pipelineService.isDynamicRendering()) {
+        std::array<VkClearValue, 2> clearValues = {colorClear, depthClear};
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = pipelineService.getRenderPass();
+        renderPassInfo.framebuffer = pipelineService.getFramebuffer(imageIndex);
+        renderPassInfo.renderArea = renderArea;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    // Both attachments get cleared, so their old contents (and layouts) can be thrown away
+    std::array<VkImageMemoryBarrier2, 2> barriers{};
+
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT; // Chains with the acquire semaphore wait
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = swapChainService.getImage(imageIndex);
+    barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    // The depth image is shared by every frame in flight, so wait for the previous frame's depth writes
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    // The other findDepthFormat candidates carry stencil too
+    if (pipelineService.getDepthFormat() != VK_FORMAT_D32_SFLOAT) {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+
+    barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barriers[1].srcStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    barriers[1].srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = swapChainService.getDepthImage();
+    barriers[1].subresourceRange = {depthAspect, 0, 1, 0, 1};
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+    dependencyInfo.pImageMemoryBarriers = barriers.data();
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = swapChainService.getImageView(imageIndex);
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = colorClear;
+
+    VkRenderingAttachmentInfo depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = swapChainService.getDepthImageView();
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue = depthClear;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.flags = secondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+    renderingInfo.renderArea = renderArea;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void CommandService::endRendering(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    if (!pipelineService.isDynamicRendering()) {
+        vkCmdEndRenderPass(commandBuffer);
+        return;
+    }
+
+    vkCmdEndRendering(commandBuffer);
+
+    // What the render pass's final layout used to do
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE; // Present waits on the semaphore, readbacks on the timeline
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    barrier.newLayout = swapChainService.getFinalLayout();
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapChainService.getImage(imageIndex);
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    VkDependencyInfo dependencyInfo{};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void CommandService::recordSecondaryCommandBuffers(uint32_t imageIndex, const DrawList& drawList, uint32_t chunkCount) {
+    uint32_t firstSlot = currentFrame * workerPool.getWorkerCount();
+    size_t chunkSize = (drawList.size() + chunkCount - 1) / chunkCount;
+
+    // Contiguous chunks keep the sorted runs intact, so each worker still skips redundant binds
+    workerPool.parallelFor(chunkCount, [&](uint32_t chunk) {
+        VkCommandPool pool = workerCommandPools[firstSlot + chunk];
+        VkCommandBuffer secondary = workerCommandBuffers[firstSlot + chunk];
+
+        vkResetCommandPool(deviceService.device(), pool, 0);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        // The profiler may have a statistics query running around the pass
+        inheritanceInfo.pipelineStatistics = profiler.getInheritedStatistics();
+
+        // Dynamic rendering has no render pass to inherit, the secondaries get the attachment formats instead
+        VkFormat colorFormat = pipelineService.getColorFormat();
+        VkCommandBufferInheritanceRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachmentFormats = &colorFormat;
+        renderingInfo.depthAttachmentFormat = pipelineService.getDepthFormat();
+        renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        if (pipelineService.isDynamicRendering()) {
+            inheritanceInfo.pNext = &renderingInfo;
+        } else {
+            inheritanceInfo.renderPass = pipelineService.getRenderPass();
+            inheritanceInfo.subpass = 0;
+            inheritanceInfo.framebuffer = pipelineService.getFramebuffer(imageIndex);
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin secondary command buffer!");
+        }
+
+        // Secondaries inherit nothing but the render pass, so set up the dynamic state again
+        recordFrameState(secondary);
+
+        size_t begin = chunk * chunkSize;
+        size_t end = std::min(begin + chunkSize, drawList.size());
+        recordDraws(secondary, drawList, begin, end);
+
+        if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record secondary command buffer!");
+        }
+    });
+}
+
+void CommandService::recordFrameState(VkCommandBuffer commandBuffer) {
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)swapChainService.getSwapChainExtent().width;
+    viewport.height = (float)swapChainService.getSwapChainExtent().height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapChainService.getSwapChainExtent();
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // Every mesh lives in the shared arenas, so these are bound once per command buffer
+    VkBuffer vertexBuffers[] = {bufferService.getVertexBuffer()}; 
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+    vkCmdBindIndexBuffer(commandBuffer, bufferService.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
+}
+
+void CommandService::recordDraws(VkCommandBuffer commandBuffer, const DrawList& drawList, size_t begin, size_t end) {
+    const std::vector<DrawItem>& items = drawList.getItems();
+    const std::vector<uint32_t>& order = drawList.getOrder();
+    VkPipelineLayout pipelineLayout = bindlessFrame ? pipelineService.getBindlessPipelineLayout() : pipelineService.getPipelineLayout();
+
+    if (bindlessFrame) {
+        // Once per command buffer, draws after this only pick their objects by firstInstance
+        VkDescriptorSet bindlessSet = bindlessRegistry.getDescriptorSet();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessSet, 0, nullptr);
+
+        BindlessConstants constants{objectBufferSlots[currentFrame]};
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(BindlessConstants), &constants);
+    } else {
+        // Same object data for every draw in the frame, the draws just push their index into it
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &objectDataSet, 1, &objectDataOffset);
+    }
+
+    // The list is sorted, so only bind when the state actually changes
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+    uint32_t recordedDraws = 0;
+
+    for (size_t i = begin; i < end;) {
+        const DrawItem& item = items[order[i]];
+
+        // Same mesh and material right after each other (the sort puts them together) go out as one instanced draw
+        size_t runEnd = i + 1;
+        while (runEnd < end) {
+            const DrawItem& next = items[order[runEnd]];
+            if (next.mesh != item.mesh || next.pipeline != item.pipeline || next.descriptorSet != item.descriptorSet) {
+                break;
+            }
+            runEnd++;
+        }
+
+        if (item.pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bindlessFrame ? pipelineService.getBindlessVariant(item.pipeline) : item.pipeline);
+            boundPipeline = item.pipeline;
+        }
+
+        if (item.descriptorSet != boundDescriptorSet) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &item.descriptorSet, 0, nullptr);
+            boundDescriptorSet = item.descriptorSet;
+        }
+
+        // The run's instances are objects i to runEnd - 1. The bindless variant reads the index from firstInstance,
+        // the standard one from the push constants.
+        uint32_t firstInstance = static_cast<uint32_t>(i);
+        if (!bindlessFrame) {
+            DrawConstants constants{firstInstance};
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &constants);
+            firstInstance = 0;
+        }
+
+        vkCmdDrawIndexed(commandBuffer, item.mesh->indexCount, static_cast<uint32_t>(runEnd - i), item.mesh->firstIndex, item.mesh->vertexOffset, firstInstance);
+        recordedDraws++;
+
+        i = runEnd;
+    }
+
+    drawCalls.fetch_add(recordedDraws, std::memory_order_relaxed);
+}
+
+void CommandService::recordIndirectDraws(VkCommandBuffer commandBuffer) {
+    VkPipelineLayout pipelineLayout = pipelineService.getIndirectPipelineLayout();
+    VkBuffer drawBuffer = cullingService.getDrawBuffer(currentFrame);
+    VkBuffer countBuffer = cullingService.getCountBuffer(currentFrame);
+    VkDescriptorSet objectSet = cullingService.getObjectSet(currentFrame);
+
+    // One call per batch, the GPU decides how many of its draws survived
+    const std::vector<IndirectBatch>& batches = cullingService.getBatches();
+    for (uint32_t i = 0; i < batches.size(); i++) {
+        const IndirectBatch& batch = batches[i];
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineService.getIndirectVariant(batch.pipeline));
+
+        VkDescriptorSet sets[] = {batch.descriptorSet, objectSet};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, sets, 0, nullptr);
+
+        vkCmdDrawIndexedIndirectCount(commandBuffer,
+            drawBuffer, batch.drawBase * sizeof(VkDrawIndexedIndirectCommand),
+            countBuffer, i * sizeof(uint32_t),
+            batch.maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+bool CommandService::hasBindlessVariants(const DrawList& drawList) {
+    // Sorted, so each pipeline only has to be looked up once
+    VkPipeline checkedPipeline = VK_NULL_HANDLE;
+    for (uint32_t index : drawList.getOrder()) {
+        VkPipeline pipeline = drawList.getItems()[index].pipeline;
+        if (pipeline == checkedPipeline) {
+            continue;
+        }
+        if (pipelineService.getBindlessVariant(pipeline) == VK_NULL_HANDLE) {
+            return false;
+        }
+        checkedPipeline = pipeline;
+    }
+    return true;
+}
+
+void CommandService::waitForFrameSlot() {
+    AURELIUS_TRACE("Wait for frame slot");
+    frameScheduler.wait(QueueType::Graphics, frameTimelineValues[currentFrame]);
+
+    // Sets this slot allocated per frame last time round are done with too
+    if (descriptorResetValues[currentFrame] != frameTimelineValues[currentFrame]) {
+        deviceService.getDescriptorAllocator().resetFrame(currentFrame);
+        descriptorResetValues[currentFrame] = frameTimelineValues[currentFrame];
+    }
+}
+
+VkResult CommandService::drawFrame(DrawList& drawList) {
+    // This slot's command buffer and per-frame buffers are free once its last submit retired.
+    // Returns straight away if the caller already did it with waitForFrameSlot.
+    waitForFrameSlot();
+
+    telemetry.collect();
+
+    // Free whatever the frames that just retired were the last users of
+    deviceService.getDeletionQueue().collect(frameScheduler.completedValue(QueueType::Graphics));
+    bindlessRegistry.collect(frameScheduler.completedValue(QueueType::Graphics));
+    deviceService.getMemoryBudget().update(static_cast<uint32_t>(frameScheduler.pendingValue(QueueType::Graphics)));
 
     uint32_t imageIndex;
-    VkResult result = swapChainService.acquireNextImage(imageAvailableSemaphores[currentFrame], &imageIndex);
+    VkResult result;
+    {
+        AURELIUS_TRACE("Acquire");
+        result = swapChainService.acquireNextImage(imageAvailableSemaphores[currentFrame], &imageIndex);
+    }
 
     // Check if window was resized before we start drawing
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Nothing is submitted and the slot comes straight back, so waitForFrameSlot won't reset it. Drop the sets
+        // allocated for this attempt now (the GPU never saw them) instead of piling the retry's on top.
+        deviceService.getDescriptorAllocator().resetFrame(currentFrame);
         return result;
     }
 
@@ -136,37 +630,113 @@ VkResult CommandService::drawFrame(const Mesh& mesh, VkDescriptorSet descriptorS
         throw std::runtime_error("Failed to acquire swap chain image!");
     }
 
-    // Only reset fence if we are actually going to submit work
-    vkResetFences(deviceService.device(), 1, &inFlightFences[currentFrame]);
-
     vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+
+    // Every pipeline in the list needs an indirect variant, otherwise draw it the CPU way
+    cullWaitValue = 0;
+    if (gpuDrivenRendering && cullingService.isSupported() && drawList.size() > 0 && drawList.size() <= cullingService.getMaxObjects()) {
+        drawList.sort();
+        listSorted = true;
+
+        // Sorted, so each pipeline only has to be looked up once
+        bool hasIndirectVariants = true;
+        VkPipeline checkedPipeline = VK_NULL_HANDLE;
+        for (uint32_t index : drawList.getOrder()) {
+            VkPipeline pipeline = drawList.getItems()[index].pipeline;
+            if (pipeline == checkedPipeline) {
+                continue;
+            }
+            if (pipelineService.getIndirectVariant(pipeline) == VK_NULL_HANDLE) {
+                hasIndirectVariants = false;
+                break;
+            }
+            checkedPipeline = pipeline;
+        }
+
+        if (hasIndirectVariants) {
+            cullWaitValue = cullingService.cull(currentFrame, drawList);
+        }
+    }
+
+    // Uploads recorded since the last frame go out now, this frame waits on them on the GPU only
+    uploadService.flush();
     
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex, mesh, descriptorSet);
+    recordCommandBuffer(commandBuffers[currentFrame], imageIndex, drawList);
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    // Binary semaphore values are ignored
+    std::array<VkSemaphore, 3> waitSemaphores;
+    std::array<VkPipelineStageFlags, 3> waitStages;
+    std::array<uint64_t, 3> waitValues;
+    uint32_t waitCount = 0;
+
+    // Offscreen targets have nothing to acquire, the frame that last used one retired before its slot came round
+    bool headless = swapChainService.isHeadless();
+    if (!headless) {
+        waitSemaphores[waitCount] = imageAvailableSemaphores[currentFrame];
+        waitStages[waitCount] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        waitValues[waitCount++] = 0;
+    }
+
+    if (uploadWaitValue != 0) {
+        waitSemaphores[waitCount] = uploadService.getTimelineSemaphore();
+        waitStages[waitCount] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        waitValues[waitCount++] = uploadWaitValue;
+    }
+
+    if (cullWaitValue != 0) {
+        waitSemaphores[waitCount] = frameScheduler.getTimeline(QueueType::Compute);
+        waitStages[waitCount] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        waitValues[waitCount++] = cullWaitValue;
+    }
+
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+
+    // Present waits on the binary semaphore, the CPU and later frames on the graphics timeline.
+    // Nothing presents when headless, so only the timeline is signalled.
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], frameScheduler.getTimeline(QueueType::Graphics)};
+    uint64_t signalValues[] = {0, frameScheduler.pendingValue(QueueType::Graphics)};
+    uint32_t firstSignal = headless ? 1 : 0;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = 2 - firstSignal;
+    timelineInfo.pSignalSemaphoreValues = signalValues + firstSignal;
+    submitInfo.pNext = &timelineInfo;
 
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    submitInfo.signalSemaphoreCount = 2 - firstSignal;
+    submitInfo.pSignalSemaphores = signalSemaphores + firstSignal;
 
-    if (vkQueueSubmit(deviceService.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to submit draw command buffer!");
+    {
+        AURELIUS_TRACE("Submit");
+        if (vkQueueSubmit(deviceService.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit draw command buffer!");
+        }
+    }
+    frameTimelineValues[currentFrame] = frameScheduler.markSubmitted(QueueType::Graphics);
+    telemetry.frameSubmitted(currentFrame, frameTimelineValues[currentFrame]);
+    profiler.frameSubmitted(currentFrame);
+    // Anything destroyed from here on may be recorded into the next frame at the latest
+    deviceService.getDeletionQueue().setRetireValue(frameScheduler.pendingValue(QueueType::Graphics));
+
+    if (headless) {
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        return VK_SUCCESS;
     }
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
     // IMPORTANT: Point to the swapchain and image index
     VkSwapchainKHR swapChains[] = {swapChainService.getSwapChain()};
@@ -174,7 +744,10 @@ VkResult CommandService::drawFrame(const Mesh& mesh, VkDescriptorSet descriptorS
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(deviceService.presentQueue(), &presentInfo);
+    {
+        AURELIUS_TRACE("Present");
+        result = vkQueuePresentKHR(deviceService.presentQueue(), &presentInfo);
+    }
 
     // Check if window was resized during the frame
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
@@ -183,7 +756,7 @@ VkResult CommandService::drawFrame(const Mesh& mesh, VkDescriptorSet descriptorS
         throw std::runtime_error("failed to present swap chain image!");
     }
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
     
     return VK_SUCCESS;
 }
\ No newline at end of file
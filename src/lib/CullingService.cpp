@@ -0,0 +1,265 @@
+#include "../include/CullingService.h"
+#include "../include/Tracer.h"
+#include <stdexcept>
+#include <array>
+
+CullingService::CullingService(DeviceService& device, FrameScheduler& scheduler, PipelineService& pipeline, uint32_t frameCount, uint32_t objectCapacity)
+    : deviceService(device), frameScheduler(scheduler), pipelineService(pipeline), framesInFlight(frameCount), maxObjects(objectCapacity) {
+    QueueFamilyIndices indices = deviceService.findPhysicalQueueFamilies();
+    if (indices.graphicsFamily.value() != indices.computeFamily.value()) {
+        sharedFamilies = {indices.graphicsFamily.value(), indices.computeFamily.value()};
+    }
+
+    createFrameResources();
+    createDescriptorSets();
+}
+
+CullingService::~CullingService() {
+    frameScheduler.waitIdle();
+
+    std::vector<VkCommandBuffer> commandBuffers;
+    MemoryBudget& memoryBudget = deviceService.getMemoryBudget();
+    for (auto& frame : frames) {
+        memoryBudget.untrack(frame.objectAllocation);
+        memoryBudget.untrack(frame.drawAllocation);
+        memoryBudget.untrack(frame.countAllocation);
+        vmaDestroyBuffer(deviceService.getAllocator(), frame.objectBuffer, frame.objectAllocation);
+        vmaDestroyBuffer(deviceService.getAllocator(), frame.drawBuffer, frame.drawAllocation);
+        vmaDestroyBuffer(deviceService.getAllocator(), frame.countBuffer, frame.countAllocation);
+        commandBuffers.push_back(frame.commandBuffer);
+    }
+
+    vkFreeCommandBuffers(deviceService.device(), deviceService.getComputeCommandPool(),
+        static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+}
+
+void CullingService::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer& buffer, VmaAllocation& allocation, void** mapped) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+
+    if (sharedFamilies.empty()) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    } else {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies.size());
+        bufferInfo.pQueueFamilyIndices = sharedFamilies.data();
+    }
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = memoryUsage;
+    if (mapped) {
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    }
+
+    VmaAllocationInfo allocationInfo{};
+    if (vmaCreateBuffer(deviceService.getAllocator(), &bufferInfo, &allocInfo, &buffer, &allocation, &allocationInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create culling buffer!");
+    }
+    deviceService.getMemoryBudget().track(allocation, MemoryCategory::Culling);
+
+    if (mapped) {
+        *mapped = allocationInfo.pMappedData;
+    }
+}
+
+void CullingService::createFrameResources() {
+    frames.resize(framesInFlight);
+
+    std::vector<VkCommandBuffer> commandBuffers(framesInFlight);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = deviceService.getComputeCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = framesInFlight;
+
+    if (vkAllocateCommandBuffers(deviceService.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate culling command buffers!");
+    }
+
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        FrameResources& frame = frames[i];
+
+        // Written by the CPU every frame, read by the culling pass and the vertex shader
+        void* mapped = nullptr;
+        createBuffer(sizeof(GpuObjectData) * maxObjects, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU, frame.objectBuffer, frame.objectAllocation, &mapped);
+        frame.objects = static_cast<GpuObjectData*>(mapped);
+
+        createBuffer(sizeof(VkDrawIndexedIndirectCommand) * maxObjects,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, frame.drawBuffer, frame.drawAllocation, nullptr);
+
+        // Worst case every object is its own batch
+        createBuffer(sizeof(uint32_t) * maxObjects,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY, frame.countBuffer, frame.countAllocation, nullptr);
+
+        frame.commandBuffer = commandBuffers[i];
+    }
+}
+
+void CullingService::createDescriptorSets() {
+    // Per frame: 3 buffers for the culling pass + 1 for the vertex shader, out of the shared allocator
+    DescriptorAllocator& descriptorAllocator = deviceService.getDescriptorAllocator();
+
+    // Both templates read the bufferInfos array below, binding i from element i
+    std::vector<VkDescriptorUpdateTemplateEntry> cullEntries(3);
+    for (uint32_t i = 0; i < cullEntries.size(); i++) {
+        cullEntries[i].dstBinding = i;
+        cullEntries[i].descriptorCount = 1;
+        cullEntries[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullEntries[i].offset = i * sizeof(VkDescriptorBufferInfo);
+        cullEntries[i].stride = sizeof(VkDescriptorBufferInfo);
+    }
+    VkDescriptorUpdateTemplate cullTemplate = descriptorAllocator.createUpdateTemplate(pipelineService.getCullSetLayout(), cullEntries);
+    // The vertex shader reads the same object buffer
+    VkDescriptorUpdateTemplate objectTemplate = descriptorAllocator.createUpdateTemplate(pipelineService.getObjectSetLayout(), {cullEntries[0]});
+
+    for (auto& frame : frames) {
+        frame.cullSet = descriptorAllocator.allocate(pipelineService.getCullSetLayout());
+        frame.objectSet = descriptorAllocator.allocate(pipelineService.getObjectSetLayout());
+
+        std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+        bufferInfos[0] = {frame.objectBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[1] = {frame.drawBuffer, 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {frame.countBuffer, 0, VK_WHOLE_SIZE};
+
+        descriptorAllocator.update(frame.cullSet, cullTemplate, bufferInfos.data());
+        descriptorAllocator.update(frame.objectSet, objectTemplate, bufferInfos.data());
+    }
+}
+
+void CullingService::buildBatches(const DrawList& drawList, GpuObjectData* objects) {
+    const std::vector<DrawItem>& items = drawList.getItems();
+    const std::vector<uint32_t>& order = drawList.getOrder();
+
+    batches.clear();
+
+    // Objects go out in sorted order, so every batch is one contiguous range of the draw buffer
+    for (uint32_t i = 0; i < order.size(); i++) {
+        const DrawItem& item = items[order[i]];
+
+        if (batches.empty() || batches.back().pipeline != item.pipeline || batches.back().descriptorSet != item.descriptorSet) {
+            batches.push_back({item.pipeline, item.descriptorSet, i, 0});
+        }
+        IndirectBatch& batch = batches.back();
+        batch.maxDraws++;
+
+        GpuObjectData& object = objects[i];
+        object.model = item.transform;
+        object.boundingSphere = glm::vec4(item.mesh->boundsCenter, item.mesh->boundsRadius);
+        object.color = item.color;
+        object.indexCount = item.mesh->indexCount;
+        object.firstIndex = item.mesh->firstIndex;
+        object.vertexOffset = item.mesh->vertexOffset;
+        object.batch = static_cast<uint32_t>(batches.size() - 1);
+        object.drawBase = batch.drawBase;
+    }
+}
+
+CullConstants CullingService::buildConstants(const glm::mat4& viewProjection, uint32_t objectCount) {
+    // Gribb/Hartmann plane extraction. GLM is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    // Depth is 0..1, so the near plane is just row 2.
+    auto row = [&](int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+
+    CullConstants constants{};
+    constants.planes[0] = row(3) + row(0); // Left
+    constants.planes[1] = row(3) - row(0); // Right
+    constants.planes[2] = row(3) + row(1); // Bottom
+    constants.planes[3] = row(3) - row(1); // Top
+    constants.planes[4] = row(2);          // Near
+    constants.planes[5] = row(3) - row(2); // Far
+
+    for (auto& plane : constants.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    constants.objectCount = objectCount;
+    return constants;
+}
+
+uint64_t CullingService::cull(uint32_t frameIndex, const DrawList& drawList) {
+    AURELIUS_TRACE("CullingService::cull");
+    if (drawList.size() > maxObjects) {
+        throw std::runtime_error("Draw list exceeds the culling capacity!");
+    }
+
+    FrameResources& frame = frames[frameIndex];
+    uint32_t objectCount = static_cast<uint32_t>(drawList.size());
+
+    // 1. Object data (mapped, host coherent)
+    buildBatches(drawList, frame.objects);
+
+    // 2. Record the culling pass
+    vkResetCommandBuffer(frame.commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin culling command buffer!");
+    }
+
+    if (!batches.empty()) {
+        vkCmdFillBuffer(frame.commandBuffer, frame.countBuffer, 0, sizeof(uint32_t) * batches.size(), 0);
+
+        VkBufferMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        clearBarrier.buffer = frame.countBuffer;
+        clearBarrier.offset = 0;
+        clearBarrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(
+            frame.commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            1, &clearBarrier,
+            0, nullptr);
+
+        CullConstants constants = buildConstants(drawList.getViewProjection(), objectCount);
+
+        vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineService.getCullPipeline());
+        vkCmdBindDescriptorSets(frame.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineService.getCullPipelineLayout(), 0, 1, &frame.cullSet, 0, nullptr);
+        vkCmdPushConstants(frame.commandBuffer, pipelineService.getCullPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+        vkCmdDispatch(frame.commandBuffer, (objectCount + 63) / 64, 1, 1);
+    }
+
+    if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record culling command buffer!");
+    }
+
+    // 3. Submit, graphics waits on the compute timeline at DRAW_INDIRECT
+    uint64_t signalValue = frameScheduler.pendingValue(QueueType::Compute);
+    VkSemaphore timeline = frameScheduler.getTimeline(QueueType::Compute);
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timeline;
+
+    if (vkQueueSubmit(deviceService.computeQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit culling pass!");
+    }
+
+    return frameScheduler.markSubmitted(QueueType::Compute);
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "../include/DeletionQueue.h"
+#include "../include/Tracer.h"
+#include "../include/DeviceService.h"
+
+DeletionQueue::DeletionQueue(DeviceService& device) : deviceService(device) {}
+
+void DeletionQueue::push(std::function<void()> destroy) {
+    push(retireValue, std::move(destroy));
+}
+
+void DeletionQueue::push(uint64_t value, std::function<void()> destroy) {
+    entries.push_back({value, std::move(destroy)});
+}
+
+void DeletionQueue::destroyBuffer(VkBuffer buffer, VmaAllocation allocation) {
+    VmaAllocator allocator = deviceService.getAllocator();
+    MemoryBudget* memoryBudget = &deviceService.getMemoryBudget();
+    push([allocator, memoryBudget, buffer, allocation]() {
+        memoryBudget->untrack(allocation);
+        vmaDestroyBuffer(allocator, buffer, allocation);
+    });
+}
+
+void DeletionQueue::destroyImage(VkImage image, VmaAllocation allocation) {
+    VmaAllocator allocator = deviceService.getAllocator();
+    MemoryBudget* memoryBudget = &deviceService.getMemoryBudget();
+    push([allocator, memoryBudget, image, allocation]() {
+        memoryBudget->untrack(allocation);
+        vmaDestroyImage(allocator, image, allocation);
+    });
+}
+
+void DeletionQueue::destroyImageView(VkImageView imageView) {
+    VkDevice device = deviceService.device();
+    push([device, imageView]() {
+        vkDestroyImageView(device, imageView, nullptr);
+    });
+}
+
+void DeletionQueue::destroyPipeline(VkPipeline pipeline) {
+    VkDevice device = deviceService.device();
+    push([device, pipeline]() {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    });
+}
+
+void DeletionQueue::destroyFramebuffer(VkFramebuffer framebuffer) {
+    VkDevice device = deviceService.device();
+    push([device, framebuffer]() {
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    });
+}
+
+void DeletionQueue::destroyRenderPass(VkRenderPass renderPass) {
+    VkDevice device = deviceService.device();
+    push([device, renderPass]() {
+        vkDestroyRenderPass(device, renderPass, nullptr);
+    });
+}
+
+void DeletionQueue::destroyDescriptorPool(VkDescriptorPool descriptorPool) {
+    VkDevice device = deviceService.device();
+    push([device, descriptorPool]() {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    });
+}
+
+void DeletionQueue::destroySwapchain(VkSwapchainKHR swapchain) {
+    VkDevice device = deviceService.device();
+    push([device, swapchain]() {
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+    });
+}
+
+void DeletionQueue::collect(uint64_t completedValue) {
+    AURELIUS_TRACE("DeletionQueue::collect");
+    while (!entries.empty() && entries.front().retireValue <= completedValue) {
+        // Pop first, destroy callbacks are allowed to push
+        std::function<void()> destroy = std::move(entries.front().destroy);
+        entries.pop_front();
+        destroy();
+    }
+}
+
+void DeletionQueue::flush() {
+    while (!entries.empty()) {
+        std::function<void()> destroy = std::move(entries.front().destroy);
+        entries.pop_front();
+        destroy();
+    }
+}
\ No newline at end of file
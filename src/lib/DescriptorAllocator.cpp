@@ -0,0 +1,257 @@
+#include "../include/DescriptorAllocator.h"
+#include "../include/DeviceService.h"
+#include "../include/HashCombine.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+// Rough mix of what the engine's layouts ask for, per set
+static const std::vector<std::pair<VkDescriptorType, float>> POOL_RATIOS = {
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f},
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+};
+
+DescriptorAllocator::DescriptorAllocator(DeviceService& device) : deviceService(device) {}
+
+void DescriptorAllocator::destroy() {
+    destroyChain(persistentChain);
+    for (PoolChain& chain : frameChains) {
+        destroyChain(chain);
+    }
+    frameChains.clear();
+
+    for (VkDescriptorUpdateTemplate updateTemplate : updateTemplates) {
+        vkDestroyDescriptorUpdateTemplate(deviceService.device(), updateTemplate, nullptr);
+    }
+    updateTemplates.clear();
+
+    for (auto& [key, layout] : layoutCache) {
+        vkDestroyDescriptorSetLayout(deviceService.device(), layout, nullptr);
+    }
+    layoutCache.clear();
+}
+
+void DescriptorAllocator::destroyChain(PoolChain& chain) {
+    for (VkDescriptorPool pool : chain.readyPools) {
+        vkDestroyDescriptorPool(deviceService.device(), pool, nullptr);
+    }
+    for (VkDescriptorPool pool : chain.fullPools) {
+        vkDestroyDescriptorPool(deviceService.device(), pool, nullptr);
+    }
+    chain = PoolChain{};
+}
+
+bool DescriptorAllocator::LayoutKey::operator==(const LayoutKey& other) const {
+    if (flags != other.flags || bindingFlags != other.bindingFlags || bindings.size() != other.bindings.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const VkDescriptorSetLayoutBinding& a = bindings[i];
+        const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+        // Immutable samplers compare by pointer, not by the samplers in the array, so the same array has to be passed
+        // again to hit the cache
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+            a.stageFlags != b.stageFlags || a.pImmutableSamplers != b.pImmutableSamplers) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t DescriptorAllocator::LayoutKeyHash::operator()(const LayoutKey& key) const {
+    size_t seed = 0;
+    hashCombine(seed, key.flags);
+    for (const VkDescriptorSetLayoutBinding& binding : key.bindings) {
+        hashCombine(seed, binding.binding);
+        hashCombine(seed, binding.descriptorType);
+        hashCombine(seed, binding.descriptorCount);
+        hashCombine(seed, binding.stageFlags);
+        hashCombine(seed, std::hash<const void*>()(binding.pImmutableSamplers));
+    }
+    for (VkDescriptorBindingFlags bindingFlags : key.bindingFlags) {
+        hashCombine(seed, bindingFlags);
+    }
+    return seed;
+}
+
+VkDescriptorSetLayout DescriptorAllocator::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    const std::vector<VkDescriptorBindingFlags>& bindingFlags, VkDescriptorSetLayoutCreateFlags flags) {
+    if (!bindingFlags.empty() && bindingFlags.size() != bindings.size()) {
+        throw std::runtime_error("Descriptor binding flags must match the bindings!");
+    }
+
+    // Sorted by binding so the order they were listed in doesn't matter, the flags move with their binding
+    std::vector<size_t> order(bindings.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bindings[a].binding < bindings[b].binding; });
+
+    LayoutKey key;
+    key.flags = flags;
+    for (size_t i : order) {
+        key.bindings.push_back(bindings[i]);
+        if (!bindingFlags.empty()) {
+            key.bindingFlags.push_back(bindingFlags[i]);
+        }
+    }
+
+    auto it = layoutCache.find(key);
+    if (it != layoutCache.end()) {
+        return it->second;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(key.bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = key.bindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = key.bindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+    layoutInfo.flags = flags;
+    layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+    layoutInfo.pBindings = key.bindings.data();
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(deviceService.device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor set layout!");
+    }
+
+    layoutCache.emplace(std::move(key), layout);
+    return layout;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+    stats.persistentSets++;
+    return allocateFrom(persistentChain, layout);
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrame(uint32_t frameIndex, VkDescriptorSetLayout layout) {
+    if (frameIndex >= frameChains.size()) {
+        frameChains.resize(frameIndex + 1);
+    }
+    stats.frameSets++;
+    return allocateFrom(frameChains[frameIndex], layout);
+}
+
+void DescriptorAllocator::resetFrame(uint32_t frameIndex) {
+    if (frameIndex >= frameChains.size()) {
+        return;
+    }
+
+    // Full pools go back to the ready list, the chain keeps the size it grew to
+    PoolChain& chain = frameChains[frameIndex];
+    chain.readyPools.insert(chain.readyPools.end(), chain.fullPools.begin(), chain.fullPools.end());
+    chain.fullPools.clear();
+    for (VkDescriptorPool pool : chain.readyPools) {
+        vkResetDescriptorPool(deviceService.device(), pool, 0);
+    }
+    stats.frameResets++;
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrom(PoolChain& chain, VkDescriptorSetLayout layout) {
+    if (chain.readyPools.empty()) {
+        addPool(chain);
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = chain.readyPools.back();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet descriptorSet;
+    VkResult result = vkAllocateDescriptorSets(deviceService.device(), &allocInfo, &descriptorSet);
+
+    // Out of sets or of one descriptor type: park the pool and try once more with the next one
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        chain.fullPools.push_back(chain.readyPools.back());
+        chain.readyPools.pop_back();
+        if (chain.readyPools.empty()) {
+            addPool(chain);
+        }
+
+        allocInfo.descriptorPool = chain.readyPools.back();
+        result = vkAllocateDescriptorSets(deviceService.device(), &allocInfo, &descriptorSet);
+    }
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate descriptor set!");
+    }
+    return descriptorSet;
+}
+
+void DescriptorAllocator::addPool(PoolChain& chain) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto& [type, ratio] : POOL_RATIOS) {
+        poolSizes.push_back({type, static_cast<uint32_t>(ratio * chain.setsPerPool)});
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = chain.setsPerPool;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(deviceService.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor pool!");
+    }
+    chain.readyPools.push_back(pool);
+
+    if (chain.poolCount > 0) {
+        stats.poolGrowths++;
+    }
+    chain.poolCount++;
+    chain.setsPerPool = std::min(chain.setsPerPool * 2, MAX_SETS_PER_POOL);
+}
+
+VkDescriptorUpdateTemplate DescriptorAllocator::createUpdateTemplate(VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntry>& entries) {
+    VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    templateInfo.pDescriptorUpdateEntries = entries.data();
+    templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    templateInfo.descriptorSetLayout = layout;
+
+    VkDescriptorUpdateTemplate updateTemplate;
+    if (vkCreateDescriptorUpdateTemplate(deviceService.device(), &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor update template!");
+    }
+    updateTemplates.push_back(updateTemplate);
+    return updateTemplate;
+}
+
+void DescriptorAllocator::update(VkDescriptorSet descriptorSet, VkDescriptorUpdateTemplate updateTemplate, const void* data) {
+    vkUpdateDescriptorSetWithTemplate(deviceService.device(), descriptorSet, updateTemplate, data);
+    stats.templateUpdates++;
+}
+
+DescriptorStats DescriptorAllocator::getStats() const {
+    DescriptorStats result = stats;
+    result.persistentPools = persistentChain.poolCount;
+    result.framePools = 0;
+    for (const PoolChain& chain : frameChains) {
+        result.framePools += chain.poolCount;
+    }
+    result.cachedLayouts = static_cast<uint32_t>(layoutCache.size());
+    return result;
+}
+
+void DescriptorAllocator::printReport() const {
+    DescriptorStats current = getStats();
+    std::cout << "\nDescriptors" << std::endl;
+    std::cout << "  Persistent: " << current.persistentSets << " sets from " << current.persistentPools << " pools" << std::endl;
+    std::cout << "  Per frame: " << current.frameSets << " sets from " << current.framePools << " pools, "
+              << current.frameResets << " resets" << std::endl;
+    std::cout << "  Pool growths " << current.poolGrowths << " | cached layouts " << current.cachedLayouts
+              << " | template updates " << current.templateUpdates << std::endl;
+}
\ No newline at end of file
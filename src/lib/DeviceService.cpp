@@ -5,26 +5,52 @@
 #include <stdexcept>
 #include <vector>
 #include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 // Constructor: handling initialization order
 DeviceService::DeviceService(WindowService &window) : windowService(window)
 {
+    // Offscreen rendering needs neither a surface nor the swapchain extension
+    headless = windowService.isHeadless();
+    if (headless)
+    {
+        deviceExtensions.clear();
+    }
+
     createInstance();
     // Create the surface immediately after instance, before physical device selection
-    windowService.createWindowSurface(instance, &surface_);
+    if (!headless)
+    {
+        windowService.createWindowSurface(instance, &surface_);
+    }
     pickPhysicalDevice();
     createLogicalDevice();
+    setupTimestampCalibration();
     createAllocator();
     createCommandPool();
 }
 
 DeviceService::~DeviceService()
 {
+    // Every service is gone and has drained its queues by now
+    deletionQueue.flush();
+    descriptorAllocator.destroy();
+
     vmaDestroyAllocator(allocator);
+    vkDestroyCommandPool(device_, computeCommandPool, nullptr);
     vkDestroyCommandPool(device_, transferCommandPool, nullptr);
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
-    vkDestroySurfaceKHR(instance, surface_, nullptr);
+    if (surface_ != VK_NULL_HANDLE)
+    {
+        vkDestroySurfaceKHR(instance, surface_, nullptr);
+    }
     vkDestroyInstance(instance, nullptr);
 }
 
@@ -38,8 +64,9 @@ void DeviceService::createInstance()
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.apiVersion = VK_API_VERSION_1_3; // Requesting Vulkan 1.3 for modern features
 
+    // GLFW isn't initialized in headless mode, and nothing needs the surface extensions
     uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char **glfwExtensions = headless ? nullptr : glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
     const std::vector<const char *> validationLayers = {
         "VK_LAYER_KHRONOS_validation"};
@@ -117,16 +144,119 @@ void DeviceService::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // What the device can do, optional features are only turned on when present
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice_, &deviceProperties);
+    bool vulkan13 = deviceProperties.apiVersion >= VK_API_VERSION_1_3;
+
+    VkPhysicalDeviceVulkan13Features supported13{};
+    supported13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    VkPhysicalDeviceVulkan12Features supported12{};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supported12.pNext = vulkan13 ? &supported13 : nullptr;
+    VkPhysicalDeviceFeatures2 supportedFeatures{};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice_, &supportedFeatures);
+
+    indirectCountSupported = supported12.drawIndirectCount &&
+                             supportedFeatures.features.multiDrawIndirect &&
+                             supportedFeatures.features.drawIndirectFirstInstance;
+
+    dynamicRenderingSupported = vulkan13 && supported13.dynamicRendering && supported13.synchronization2;
+
+    // Bindless resources: big descriptor arrays that are written while in use, only partly filled and indexed
+    // with values only known in the shader
+    bindlessSupported = supportedFeatures.features.shaderStorageBufferArrayDynamicIndexing &&
+                        supportedFeatures.features.shaderSampledImageArrayDynamicIndexing &&
+                        supported12.descriptorIndexing &&
+                        supported12.runtimeDescriptorArray &&
+                        supported12.descriptorBindingPartiallyBound &&
+                        supported12.descriptorBindingUpdateUnusedWhilePending &&
+                        supported12.descriptorBindingStorageBufferUpdateAfterBind &&
+                        supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                        supported12.shaderSampledImageArrayNonUniformIndexing;
+
+    if (bindlessSupported)
+    {
+        VkPhysicalDeviceVulkan12Properties properties12{};
+        properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &properties12;
+        vkGetPhysicalDeviceProperties2(physicalDevice_, &properties2);
+
+        bindlessLimits.storageBuffers = std::min(properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers);
+        bindlessLimits.sampledImages = std::min(properties12.maxPerStageDescriptorUpdateAfterBindSampledImages, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+        bindlessLimits.samplers = std::min(properties12.maxPerStageDescriptorUpdateAfterBindSamplers, properties12.maxDescriptorSetUpdateAfterBindSamplers);
+        bindlessLimits.resources = properties12.maxPerStageUpdateAfterBindResources;
+    }
+
+    // Profiling only, both are optional
+    pipelineStatisticsSupported = supportedFeatures.features.pipelineStatisticsQuery;
+    inheritedQueriesSupported = pipelineStatisticsSupported && supportedFeatures.features.inheritedQueries;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &queueFamilyCount, queueFamilies.data());
+    timestampPeriod_ = deviceProperties.limits.timestampPeriod;
+    timestampValidBits = timestampPeriod_ > 0.0f ? queueFamilies[indices.graphicsFamily.value()].timestampValidBits : 0;
+
     // Will be used for later integrations
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.multiDrawIndirect = indirectCountSupported;
+    deviceFeatures.drawIndirectFirstInstance = indirectCountSupported;
+    deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsSupported;
+    deviceFeatures.inheritedQueries = inheritedQueriesSupported;
+    deviceFeatures.shaderStorageBufferArrayDynamicIndexing = bindlessSupported;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = bindlessSupported;
+
+    // Timeline semaphores let the upload queue hand out tickets instead of idling the queue
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    vulkan12Features.drawIndirectCount = indirectCountSupported;
+    vulkan12Features.descriptorIndexing = bindlessSupported;
+    vulkan12Features.runtimeDescriptorArray = bindlessSupported;
+    vulkan12Features.descriptorBindingPartiallyBound = bindlessSupported;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = bindlessSupported;
+    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = bindlessSupported;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = bindlessSupported;
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = bindlessSupported;
+
+    // Render straight into image views instead of render pass + framebuffer objects
+    VkPhysicalDeviceVulkan13Features vulkan13Features{};
+    vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13Features.dynamicRendering = dynamicRenderingSupported;
+    vulkan13Features.synchronization2 = dynamicRenderingSupported;
+    if (dynamicRenderingSupported)
+    {
+        vulkan12Features.pNext = &vulkan13Features;
+    }
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &vulkan12Features;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // Optional: lets the tracer put GPU timestamps on the CPU timeline
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    calibratedTimestampsSupported = hasDeviceExtension(physicalDevice_, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    if (calibratedTimestampsSupported)
+    {
+        enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
+    // Optional: real heap budgets for MemoryBudget
+    memoryBudgetSupported = hasDeviceExtension(physicalDevice_, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudgetSupported)
+    {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (vkCreateDevice(physicalDevice_, &createInfo, nullptr, &device_) != VK_SUCCESS)
     {
@@ -158,13 +288,25 @@ void DeviceService::createCommandPool()
     VkCommandPoolCreateInfo transferPoolInfo{};
     transferPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     // Transient means "we will record and reset this very often" (optimized for short-lived commands)
-    transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    // Reset lets the upload queue recycle its command buffers once a batch retires
+    transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     transferPoolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
 
     if (vkCreateCommandPool(device_, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to create transfer command pool!");
     }
+
+    // 3. Compute Pool (GPU culling, re-recorded every frame)
+    VkCommandPoolCreateInfo computePoolInfo{};
+    computePoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    computePoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    computePoolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+
+    if (vkCreateCommandPool(device_, &computePoolInfo, nullptr, &computeCommandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create compute command pool!");
+    }
 }
 
 // --- Helper Functions ---
@@ -174,8 +316,8 @@ bool DeviceService::isDeviceSuitable(VkPhysicalDevice device)
     QueueFamilyIndices indices = findQueueFamilies(device);
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported)
+    bool swapChainAdequate = headless;
+    if (extensionsSupported && !headless)
     {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -184,6 +326,96 @@ bool DeviceService::isDeviceSuitable(VkPhysicalDevice device)
     return indices.isComplete() && extensionsSupported && swapChainAdequate;
 }
 
+bool DeviceService::hasDeviceExtension(VkPhysicalDevice device, const char* name)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto &extension : availableExtensions)
+    {
+        if (strcmp(extension.extensionName, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeviceService::setupTimestampCalibration()
+{
+    if (!calibratedTimestampsSupported || timestampValidBits == 0)
+    {
+        calibratedTimestampsSupported = false;
+        return;
+    }
+
+    // The clock steady_clock is built on
+#ifdef _WIN32
+    hostTimeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+    hostTimeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+
+    auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+    getCalibratedTimestampsEXT = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+        vkGetDeviceProcAddr(device_, "vkGetCalibratedTimestampsEXT"));
+    if (getTimeDomains == nullptr || getCalibratedTimestampsEXT == nullptr)
+    {
+        calibratedTimestampsSupported = false;
+        return;
+    }
+
+    uint32_t domainCount = 0;
+    getTimeDomains(physicalDevice_, &domainCount, nullptr);
+    std::vector<VkTimeDomainEXT> domains(domainCount);
+    getTimeDomains(physicalDevice_, &domainCount, domains.data());
+
+    bool hasDevice = false;
+    bool hasHost = false;
+    for (VkTimeDomainEXT domain : domains)
+    {
+        hasDevice |= domain == VK_TIME_DOMAIN_DEVICE_EXT;
+        hasHost |= domain == hostTimeDomain;
+    }
+    calibratedTimestampsSupported = hasDevice && hasHost;
+}
+
+bool DeviceService::getCalibratedTimestamps(uint64_t &deviceTimestamp, uint64_t &hostNanoseconds)
+{
+    if (!calibratedTimestampsSupported)
+    {
+        return false;
+    }
+
+    VkCalibratedTimestampInfoEXT infos[2]{};
+    infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+    infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+    infos[1].timeDomain = hostTimeDomain;
+
+    uint64_t timestamps[2];
+    uint64_t maxDeviation;
+    if (getCalibratedTimestampsEXT(device_, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    deviceTimestamp = timestamps[0];
+#ifdef _WIN32
+    // Performance counter ticks, converted the way steady_clock does
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    hostNanoseconds = static_cast<uint64_t>(static_cast<double>(timestamps[1]) * 1e9 / static_cast<double>(frequency.QuadPart));
+#else
+    hostNanoseconds = timestamps[1];
+#endif
+    return true;
+}
+
 bool DeviceService::checkDeviceExtensionSupport(VkPhysicalDevice device)
 {
     uint32_t extensionCount;
@@ -221,9 +453,16 @@ QueueFamilyIndices DeviceService::findQueueFamilies(VkPhysicalDevice device)
             indices.graphicsFamily = i;
         }
 
-        // 2. Present
+        // 2. Present (headless never presents, the graphics queue stands in)
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        if (headless)
+        {
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }
+        else
+        {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        }
         if (presentSupport)
         {
             indices.presentFamily = i;
@@ -334,135 +573,6 @@ void DeviceService::endSingleTimeCommands(VkCommandBuffer commandBuffer)
     vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void DeviceService::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-{
-    QueueFamilyIndices indices = findQueueFamilies(physicalDevice_);
-    uint32_t graphicsFamily = indices.graphicsFamily.value();
-    uint32_t transferFamily = indices.transferFamily.value();
-
-    // --- STEP 1: The Transfer Command (Release) ---
-
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = transferCommandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    // 1. Perform the Copy
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    // 2. Setup Barrier (Logic depends on if queues are shared or distinct)
-    VkBufferMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    barrier.size = size;
-    barrier.buffer = dstBuffer;
-    barrier.offset = 0;
-
-    if (graphicsFamily != transferFamily)
-    {
-        // CASE A: Separate Queues (Ownership Transfer - RELEASE)
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = 0; // Ignored during release
-        barrier.srcQueueFamilyIndex = transferFamily;
-        barrier.dstQueueFamilyIndex = graphicsFamily; // Giving it to Graphics
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-            0,
-            0, nullptr,
-            1, &barrier,
-            0, nullptr);
-    }
-    else
-    {
-        // CASE B: Same Queue (Just a Visibility Barrier)
-        // Even if queues are same, we must ensure Write completes before Read
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED; // No ownership change
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-            0,
-            0, nullptr,
-            1, &barrier,
-            0, nullptr);
-    }
-
-    vkEndCommandBuffer(commandBuffer);
-
-    // Submit to Transfer Queue
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(transferQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(transferQueue_);
-    vkFreeCommandBuffers(device_, transferCommandPool, 1, &commandBuffer);
-
-    // --- STEP 2: The Graphics Command (Acquire) - ONLY if queues are different ---
-
-    if (graphicsFamily != transferFamily)
-    {
-        VkCommandBufferAllocateInfo allocInfoGraphics{};
-        allocInfoGraphics.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfoGraphics.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfoGraphics.commandPool = commandPool; // Use Graphics Pool
-        allocInfoGraphics.commandBufferCount = 1;
-
-        VkCommandBuffer graphicsCmd;
-        vkAllocateCommandBuffers(device_, &allocInfoGraphics, &graphicsCmd);
-
-        VkCommandBufferBeginInfo beginInfoGraphics{};
-        beginInfoGraphics.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfoGraphics.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        vkBeginCommandBuffer(graphicsCmd, &beginInfoGraphics);
-
-        // Reuse barrier struct, just update masks for ACQUIRE
-        barrier.srcAccessMask = 0; // Ignored during acquire
-        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-        barrier.srcQueueFamilyIndex = transferFamily;
-        barrier.dstQueueFamilyIndex = graphicsFamily;
-
-        vkCmdPipelineBarrier(
-            graphicsCmd,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // Wait at the very start
-            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-            0,
-            0, nullptr,
-            1, &barrier,
-            0, nullptr);
-
-        vkEndCommandBuffer(graphicsCmd);
-
-        VkSubmitInfo submitInfoGraphics{};
-        submitInfoGraphics.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfoGraphics.commandBufferCount = 1;
-        submitInfoGraphics.pCommandBuffers = &graphicsCmd;
-
-        vkQueueSubmit(graphicsQueue_, 1, &submitInfoGraphics, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
-        vkFreeCommandBuffers(device_, commandPool, 1, &graphicsCmd);
-    }
-}
-
 void DeviceService::createAllocator()
 {
     VmaAllocatorCreateInfo allocInfo = {};
@@ -470,6 +580,10 @@ void DeviceService::createAllocator()
     allocInfo.device = device_;
     allocInfo.instance = instance;
     allocInfo.vulkanApiVersion = VK_API_VERSION_1_3;
+    if (memoryBudgetSupported)
+    {
+        allocInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
     if (vmaCreateAllocator(&allocInfo, &allocator) != VK_SUCCESS)
     {
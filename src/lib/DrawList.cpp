@@ -0,0 +1,49 @@
+#include "../include/DrawList.h"
+#include "../include/Tracer.h"
+#include <algorithm>
+
+void DrawList::add(const Mesh& mesh, VkPipeline pipeline, VkDescriptorSet descriptorSet, const glm::mat4& transform, const glm::vec4& color) {
+    // Pipeline still compiling (PipelineService::getPipeline(handle)), skip the draw this frame
+    if (pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+
+    order.push_back(static_cast<uint32_t>(items.size()));
+    items.push_back({&mesh, pipeline, descriptorSet, transform, color});
+}
+
+void DrawList::clear() {
+    // Keeps the capacity, a steady scene stops allocating after the first frame
+    items.clear();
+    order.clear();
+}
+
+void DrawList::reserve(size_t count) {
+    items.reserve(count);
+    order.reserve(count);
+    keys.reserve(count);
+}
+
+void DrawList::sort() {
+    AURELIUS_TRACE("DrawList::sort");
+    // Sort small keys instead of moving whole items (and their matrices) around
+    keys.resize(items.size());
+    for (uint32_t i = 0; i < items.size(); i++) {
+        const DrawItem& item = items[i];
+        keys[i].pipeline = (uint64_t)item.pipeline;
+        keys[i].descriptorSet = (uint64_t)item.descriptorSet;
+        keys[i].mesh = (uint64_t)item.mesh->firstIndex << 32 | (uint32_t)item.mesh->vertexOffset;
+        keys[i].index = i;
+    }
+
+    std::sort(keys.begin(), keys.end(), [](const SortKey& a, const SortKey& b) {
+        if (a.pipeline != b.pipeline) return a.pipeline < b.pipeline;
+        if (a.descriptorSet != b.descriptorSet) return a.descriptorSet < b.descriptorSet;
+        if (a.mesh != b.mesh) return a.mesh < b.mesh;
+        return a.index < b.index;
+    });
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        order[i] = keys[i].index;
+    }
+}
\ No newline at end of file
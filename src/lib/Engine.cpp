@@ -2,6 +2,9 @@
 #include <iostream>
 #include <iomanip> 
 #include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <utility>
 
 void Engine::run() {
 
@@ -29,150 +32,244 @@ void Engine::run() {
 
     squareMesh = bufferService.uploadMesh(vertices, indices);
 
+    // Loading screen: compile every material pipeline up front so the first frames don't hitch
+    std::vector<PipelineHandle> prewarmed = pipelineService.prewarm({
+        PipelineDesc::opaque("shaders/vert.spv", "shaders/frag.spv", "shaders/vert_indirect.spv", "shaders/vert_bindless.spv"),
+    });
+    cubePipeline = prewarmed[0];
+
     createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
+    createDescriptorUpdateTemplate();
+    commandService.setBindlessRendering(config.bindless);
 
     std::cout << "---------------------------------" << std::endl;
     std::cout << "   AURELIUS ENGINE INITIALIZED   " << std::endl;
     std::cout << "---------------------------------" << std::endl;
+    std::cout << "Frames in flight: " << commandService.getFramesInFlight()
+              << " | Swapchain images: " << swapChainService.getImageCount() << std::endl;
+    if (config.bindless) {
+        std::cout << "Bindless: " << (deviceService.supportsBindless() ? "on" : "not supported, using descriptor sets") << std::endl;
+    }
 
-    double lastTime = glfwGetTime();
+    // A headless window never closes, so it always runs a fixed number of frames
+    uint32_t frameLimit = config.frameCount;
+    if (frameLimit == 0 && config.headless) {
+        frameLimit = DEFAULT_HEADLESS_FRAMES;
+    }
+    uint32_t framesRendered = 0;
+
+    // steady_clock rather than glfwGetTime, GLFW isn't initialized when headless
+    auto lastTime = std::chrono::steady_clock::now();
     int nbFrames = 0;
+    auto lastPipelineCacheSave = lastTime;
+    auto runStart = lastTime;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    Tracer::get().setThreadName("Main");
+    if (config.traceFrames > 0) {
+        Tracer::get().startCapture(config.traceFrames, config.tracePath);
+    }
 
     //Main Loop
-    while (!windowService.shouldClose()) {
+    while (!windowService.shouldClose() && (frameLimit == 0 || framesRendered < frameLimit)) {
+        AURELIUS_TRACE("Frame");
+
+        // Do the waiting (free frame slot when GPU-bound, frame cap) before input is sampled rather than after,
+        // so what we render is as fresh as possible
+        commandService.waitForFrameSlot();
+        {
+            AURELIUS_TRACE("Pace");
+            framePacer.pace();
+        }
+
         //Get Window Events
-        glfwPollEvents();
+        {
+            AURELIUS_TRACE("Poll events");
+            windowService.pollEvents();
+        }
+        handlePresentPolicyKeys();
+        if (windowService.wasKeyPressed(GLFW_KEY_F6)) {
+            commandService.getProfiler().printReport();
+        }
+        if (windowService.wasKeyPressed(GLFW_KEY_F7)) {
+            Tracer::get().startCapture(DEFAULT_TRACE_FRAMES, config.tracePath);
+        }
+        if (windowService.wasKeyPressed(GLFW_KEY_F8)) {
+            deviceService.getMemoryBudget().printReport();
+            deviceService.getDescriptorAllocator().printReport();
+            deviceService.getMemoryBudget().dumpStats(MEMORY_STATS_PATH);
+        }
 
-        updateUniformBuffer(commandService.currentFrame);
+        auto currentTime = std::chrono::high_resolution_clock::now();
+        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+
+        {
+            AURELIUS_TRACE("Update frame constants");
+            updateFrameConstants(commandService.currentFrame, time);
+        }
+
+        // Pick up pipelines that finished compiling since the last frame
+        pipelineService.pollPipelines();
+
+        drawList.clear();
+        VkDescriptorSet frameSet = allocateFrameDescriptorSet(commandService.currentFrame);
+        drawList.add(squareMesh, pipelineService.resolvePipeline(cubePipeline), frameSet,
+            glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
 
         //Draw the Frame using the Command Service
-        VkResult result = commandService.drawFrame(squareMesh, descriptorSets[commandService.currentFrame]);
+        VkResult result = commandService.drawFrame(drawList);
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || windowService.wasWindowResized()) {
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || windowService.wasWindowResized() || presentPolicyChanged) {
             windowService.resetWindowResizedFlag();
+            presentPolicyChanged = false;
             recreateSwapChain();
         }
 
         // 3. FPS Counter Logic
-        double currentTime = glfwGetTime();
+        auto frameEnd = std::chrono::steady_clock::now();
         nbFrames++;
-        if (currentTime - lastTime >= 1.0) {
+        framesRendered++;
+        if (frameEnd - lastTime >= std::chrono::seconds(1)) {
+            FrameTiming timing = commandService.getTelemetry().getAverage();
             std::cout << "\rFPS: " << nbFrames 
                       << " | Frame Time: " << std::fixed << std::setprecision(3) << 1000.0 / double(nbFrames) << "ms" 
+                      << " | Submit to retire: " << timing.submitToRetire << "ms"
+                      << " | GPU Idle: " << timing.gpuIdle << "ms"
                       << "    " << std::flush; // \r allows overwriting the line
             nbFrames = 0;
-            lastTime += 1.0;
+            lastTime += std::chrono::seconds(1);
         }
-    }
 
-    // Wait for the GPU to finish the last frame before we kill the services
-    vkDeviceWaitIdle(deviceService.device());
+        // Keep the on-disk pipeline cache fresh in case we never get a clean shutdown
+        if (frameEnd - lastPipelineCacheSave >= std::chrono::duration<double>(PIPELINE_CACHE_SAVE_INTERVAL)) {
+            pipelineService.savePipelineCache();
+            lastPipelineCacheSave = frameEnd;
+        }
 
-    vkDestroyDescriptorPool(deviceService.device(), descriptorPool, nullptr);
+        Tracer::get().endFrame();
+    }
+
+    // The last frames may still be in flight, so these are only queued for deletion.
+    // The services drain the GPU and the queue on their way down.
+    DeletionQueue& deletionQueue = deviceService.getDeletionQueue();
 
-    for (size_t i = 0; i < commandService.MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < commandService.getFramesInFlight(); i++) {
         vmaUnmapMemory(deviceService.getAllocator(), uniformBuffersAllocations[i]);
-        vmaDestroyBuffer(deviceService.getAllocator(), uniformBuffers[i], uniformBuffersAllocations[i]);
+        deletionQueue.destroyBuffer(uniformBuffers[i], uniformBuffersAllocations[i]);
     }
 
     bufferService.destroyMesh(squareMesh);
 
+    if (frameLimit != 0) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+        FrameTiming timing = commandService.getTelemetry().getAverage();
+        std::cout << "\n\nRendered " << framesRendered << " frames in " << std::fixed << std::setprecision(3) << seconds << "s"
+                  << " | Frame Time: " << (framesRendered > 0 ? seconds * 1000.0 / framesRendered : 0.0) << "ms"
+                  << " | GPU Time: " << timing.gpuTime << "ms" << std::endl;
+    }
+
     std::cout << "\n\nSHUTTING DOWN..." << std::endl;
 }
 
+void Engine::setPresentPolicy(PresentPolicy policy) {
+    swapChainService.setPresentPolicy(policy);
+    framePacer.setTargetFps(policy == PresentPolicy::Capped ? config.fpsCap : 0.0);
+    presentPolicyChanged = true;
+}
+
+void Engine::handlePresentPolicyKeys() {
+    const std::pair<int, PresentPolicy> bindings[] = {
+        {GLFW_KEY_F1, PresentPolicy::Vsync},
+        {GLFW_KEY_F2, PresentPolicy::VsyncRelaxed},
+        {GLFW_KEY_F3, PresentPolicy::Mailbox},
+        {GLFW_KEY_F4, PresentPolicy::Immediate},
+        {GLFW_KEY_F5, PresentPolicy::Capped},
+    };
+    for (const auto& [key, policy] : bindings) {
+        if (windowService.wasKeyPressed(key)) {
+            setPresentPolicy(policy);
+        }
+    }
+}
+
 void Engine::recreateSwapChain() {
     swapChainService.recreateSwapChain();
 
     pipelineService.recreateFramebuffers();
+    // New aspect ratio
+    cameraDirty = true;
 }
 
 void Engine::createUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+    VkDeviceSize bufferSize = sizeof(FrameConstants);
 
-    uniformBuffers.resize(commandService.MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersAllocations.resize(commandService.MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMapped.resize(commandService.MAX_FRAMES_IN_FLIGHT);
+    uniformBuffers.resize(commandService.getFramesInFlight());
+    uniformBuffersAllocations.resize(commandService.getFramesInFlight());
+    uniformBuffersMapped.resize(commandService.getFramesInFlight());
 
-    for (size_t i = 0; i < commandService.MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < commandService.getFramesInFlight(); i++) {
         bufferService.createBuffer(
             bufferSize, 
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
             VMA_MEMORY_USAGE_CPU_TO_GPU, //CPU -> GPU
             uniformBuffers[i], 
-            uniformBuffersAllocations[i]
+            uniformBuffersAllocations[i],
+            MemoryCategory::Uniform
         );
 
         vmaMapMemory(deviceService.getAllocator(), uniformBuffersAllocations[i], &uniformBuffersMapped[i]);
     }
 }
 
-void Engine::updateUniformBuffer(uint32_t currentImage) {
-    static auto startTime = std::chrono::high_resolution_clock::now();
+void Engine::updateFrameConstants(uint32_t frameIndex, float time) {
+    if (cameraDirty) {
+        frameConstants.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+        frameConstants.proj = glm::perspective(glm::radians(45.0f), swapChainService.getSwapChainExtent().width / (float) swapChainService.getSwapChainExtent().height, 0.1f, 10.0f);
 
-    UniformBufferObject ubo{};
-    
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    
-    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    
-    ubo.proj = glm::perspective(glm::radians(45.0f), swapChainService.getSwapChainExtent().width / (float) swapChainService.getSwapChainExtent().height, 0.1f, 10.0f);
-    
-    ubo.proj[1][1] *= -1;
+        frameConstants.proj[1][1] *= -1;
 
-    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
-}
+        frameConstants.viewProj = frameConstants.proj * frameConstants.view;
+        drawList.setViewProjection(frameConstants.viewProj);
 
-void Engine::createDescriptorPool() {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(commandService.MAX_FRAMES_IN_FLIGHT);
-
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(commandService.MAX_FRAMES_IN_FLIGHT);
+        cameraDirty = false;
+        // Slots come round in order, so the next framesInFlight frames cover each of them once
+        staleFrameSlots = commandService.getFramesInFlight();
+    }
 
-    if (vkCreateDescriptorPool(deviceService.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create descriptor pool!");
+    FrameConstants* mapped = static_cast<FrameConstants*>(uniformBuffersMapped[frameIndex]);
+    if (staleFrameSlots > 0) {
+        std::memcpy(mapped, &frameConstants, offsetof(FrameConstants, time));
+        staleFrameSlots--;
     }
+    mapped->time = time;
 }
 
-void Engine::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(commandService.MAX_FRAMES_IN_FLIGHT, pipelineService.getDescriptorSetLayout());
+void Engine::createDescriptorUpdateTemplate() {
+    // Binding 0 in the shader, read straight out of a VkDescriptorBufferInfo
+    VkDescriptorUpdateTemplateEntry entry{};
+    entry.dstBinding = 0;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = 1;
+    entry.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    entry.offset = 0;
+    entry.stride = sizeof(VkDescriptorBufferInfo);
+    frameConstantsTemplate = deviceService.getDescriptorAllocator().createUpdateTemplate(pipelineService.getDescriptorSetLayout(), {entry});
+}
 
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(commandService.MAX_FRAMES_IN_FLIGHT);
-    allocInfo.pSetLayouts = layouts.data();
+VkDescriptorSet Engine::allocateFrameDescriptorSet(uint32_t frameIndex) {
+    DescriptorAllocator& descriptorAllocator = deviceService.getDescriptorAllocator();
 
-    descriptorSets.resize(commandService.MAX_FRAMES_IN_FLIGHT);
-    if (vkAllocateDescriptorSets(deviceService.device(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate descriptor sets!");
-    }
+    // Comes out of the slot's own pools, which are reset as a whole instead of freeing sets one by one
+    VkDescriptorSet descriptorSet = descriptorAllocator.allocateFrame(frameIndex, pipelineService.getDescriptorSetLayout());
 
-    // Connect the Buffers to the Sets
-    for (size_t i = 0; i < commandService.MAX_FRAMES_IN_FLIGHT; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = descriptorSets[i];
-        descriptorWrite.dstBinding = 0; // Binding 0 in Shader
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-
-        vkUpdateDescriptorSets(deviceService.device(), 1, &descriptorWrite, 0, nullptr);
-    }
+    // Connect the slot's buffer to the set
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = uniformBuffers[frameIndex];
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(FrameConstants);
+
+    descriptorAllocator.update(descriptorSet, frameConstantsTemplate, &bufferInfo);
+    return descriptorSet;
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include "../include/FramePacer.h"
+#include <thread>
+
+FramePacer::FramePacer(double fps) {
+    setTargetFps(fps);
+}
+
+void FramePacer::setTargetFps(double fps) {
+    targetFps = fps > 0.0 ? fps : 0.0;
+    frameInterval = targetFps > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps))
+        : Clock::duration{0};
+    nextFrameStart = Clock::now();
+}
+
+void FramePacer::pace() {
+    if (targetFps == 0.0) {
+        return;
+    }
+
+    auto now = Clock::now();
+    if (now < nextFrameStart) {
+        if (nextFrameStart - now > SPIN_MARGIN) {
+            std::this_thread::sleep_until(nextFrameStart - SPIN_MARGIN);
+        }
+        while (Clock::now() < nextFrameStart) {
+            std::this_thread::yield();
+        }
+        nextFrameStart += frameInterval;
+    } else {
+        // Running behind (or first frame): restart the schedule from now instead of bursting to catch up
+        nextFrameStart = now + frameInterval;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "../include/FrameScheduler.h"
+#include <stdexcept>
+
+FrameScheduler::FrameScheduler(DeviceService& device) : deviceService(device) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    for (auto& timeline : timelines) {
+        if (vkCreateSemaphore(deviceService.device(), &semaphoreInfo, nullptr, &timeline.semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timeline semaphore!");
+        }
+    }
+}
+
+FrameScheduler::~FrameScheduler() {
+    waitIdle();
+    for (auto& timeline : timelines) {
+        vkDestroySemaphore(deviceService.device(), timeline.semaphore, nullptr);
+    }
+}
+
+uint64_t FrameScheduler::markSubmitted(QueueType queue) {
+    Timeline& timeline = timelines[index(queue)];
+    timeline.lastSubmitted = timeline.nextValue++;
+    return timeline.lastSubmitted;
+}
+
+uint64_t FrameScheduler::completedValue(QueueType queue) {
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(deviceService.device(), timelines[index(queue)].semaphore, &value);
+    return value;
+}
+
+bool FrameScheduler::isComplete(QueueType queue, uint64_t value) {
+    return completedValue(queue) >= value;
+}
+
+void FrameScheduler::wait(QueueType queue, uint64_t value) {
+    // Nothing was ever submitted under this value, so nothing will signal it
+    if (value == 0 || value > timelines[index(queue)].lastSubmitted) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelines[index(queue)].semaphore;
+    waitInfo.pValues = &value;
+
+    vkWaitSemaphores(deviceService.device(), &waitInfo, UINT64_MAX);
+}
+
+void FrameScheduler::waitIdle() {
+    std::array<VkSemaphore, static_cast<size_t>(QueueType::Count)> semaphores;
+    std::array<uint64_t, static_cast<size_t>(QueueType::Count)> values;
+    for (size_t i = 0; i < timelines.size(); i++) {
+        semaphores[i] = timelines[i].semaphore;
+        values[i] = timelines[i].lastSubmitted;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+    waitInfo.pSemaphores = semaphores.data();
+    waitInfo.pValues = values.data();
+
+    vkWaitSemaphores(deviceService.device(), &waitInfo, UINT64_MAX);
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "../include/FrameTelemetry.h"
+#include <algorithm>
+#include <stdexcept>
+
+FrameTelemetry::FrameTelemetry(DeviceService& device, FrameScheduler& scheduler, uint32_t framesInFlight)
+    : deviceService(device), frameScheduler(scheduler), slots(framesInFlight) {
+    uint32_t validBits = deviceService.graphicsTimestampValidBits();
+    timestampsSupported = validBits > 0;
+    if (!timestampsSupported) {
+        return;
+    }
+
+    timestampPeriod = deviceService.timestampPeriod();
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = framesInFlight * 2;
+
+    if (vkCreateQueryPool(deviceService.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create frame telemetry query pool!");
+    }
+}
+
+FrameTelemetry::~FrameTelemetry() {
+    // The owner has drained the graphics queue by now
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(deviceService.device(), queryPool, nullptr);
+    }
+}
+
+void FrameTelemetry::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!timestampsSupported) {
+        return;
+    }
+    vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * 2, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frameIndex * 2);
+}
+
+void FrameTelemetry::endFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!timestampsSupported) {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameIndex * 2 + 1);
+}
+
+void FrameTelemetry::frameSubmitted(uint32_t frameIndex, uint64_t timelineValue) {
+    FrameSlot& slot = slots[frameIndex];
+    slot.timelineValue = timelineValue;
+    slot.submitTime = std::chrono::steady_clock::now();
+    slot.pending = true;
+}
+
+void FrameTelemetry::collect() {
+    uint64_t completed = frameScheduler.completedValue(QueueType::Graphics);
+    auto now = std::chrono::steady_clock::now();
+
+    // Oldest first, the idle gap is measured against the frame before
+    std::vector<uint32_t> retired;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        if (slots[i].pending && slots[i].timelineValue <= completed) {
+            retired.push_back(i);
+        }
+    }
+    std::sort(retired.begin(), retired.end(), [this](uint32_t a, uint32_t b) {
+        return slots[a].timelineValue < slots[b].timelineValue;
+    });
+
+    for (uint32_t frameIndex : retired) {
+        resolve(frameIndex, now);
+    }
+}
+
+void FrameTelemetry::resolve(uint32_t frameIndex, std::chrono::steady_clock::time_point retireTime) {
+    FrameSlot& slot = slots[frameIndex];
+    slot.pending = false;
+
+    FrameTiming timing;
+    timing.submitToRetire = std::chrono::duration<double, std::milli>(retireTime - slot.submitTime).count();
+
+    // The frame retired, so the results are there and this never waits
+    uint64_t timestamps[2];
+    if (timestampsSupported &&
+        vkGetQueryPoolResults(deviceService.device(), queryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps,
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        uint64_t begin = timestamps[0] & timestampMask;
+        uint64_t end = timestamps[1] & timestampMask;
+
+        timing.gpuTime = static_cast<double>(end - begin) * timestampPeriod / 1e6;
+        if (lastGpuEnd != 0 && begin > lastGpuEnd) {
+            timing.gpuIdle = static_cast<double>(begin - lastGpuEnd) * timestampPeriod / 1e6;
+        }
+        lastGpuEnd = end;
+    }
+
+    latest = timing;
+    if (history.size() < HISTORY_SIZE) {
+        history.push_back(timing);
+    } else {
+        history[historyNext] = timing;
+    }
+    historyNext = (historyNext + 1) % HISTORY_SIZE;
+}
+
+FrameTiming FrameTelemetry::getAverage() const {
+    FrameTiming average;
+    if (history.empty()) {
+        return average;
+    }
+
+    for (const FrameTiming& timing : history) {
+        average.submitToRetire += timing.submitToRetire;
+        average.gpuIdle += timing.gpuIdle;
+        average.gpuTime += timing.gpuTime;
+    }
+    average.submitToRetire /= history.size();
+    average.gpuIdle /= history.size();
+    average.gpuTime /= history.size();
+    return average;
+}
\ No newline at end of file
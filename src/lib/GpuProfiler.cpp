@@ -0,0 +1,253 @@
+#include "../include/GpuProfiler.h"
+#include "../include/Tracer.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(DeviceService& device, uint32_t framesInFlight) : deviceService(device), slots(framesInFlight) {
+    uint32_t validBits = deviceService.graphicsTimestampValidBits();
+    timestampsSupported = validBits > 0;
+    statisticsSupported = deviceService.supportsPipelineStatistics();
+    inheritedQueries = deviceService.supportsInheritedQueries();
+
+    timestampPeriod = deviceService.timestampPeriod();
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    for (FrameSlot& slot : slots) {
+        slot.scopes.reserve(MAX_SCOPES_PER_FRAME);
+
+        if (timestampsSupported) {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = MAX_SCOPES_PER_FRAME * 2;
+
+            if (vkCreateQueryPool(deviceService.device(), &poolInfo, nullptr, &slot.timestampPool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create timestamp query pool!");
+            }
+        }
+
+        if (statisticsSupported) {
+            VkQueryPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount = MAX_SCOPES_PER_FRAME;
+            poolInfo.pipelineStatistics = STATISTICS_FLAGS;
+
+            if (vkCreateQueryPool(deviceService.device(), &poolInfo, nullptr, &slot.statisticsPool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create pipeline statistics query pool!");
+            }
+        }
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    // The owner has drained the graphics queue by now
+    for (FrameSlot& slot : slots) {
+        if (slot.timestampPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(deviceService.device(), slot.timestampPool, nullptr);
+        }
+        if (slot.statisticsPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(deviceService.device(), slot.statisticsPool, nullptr);
+        }
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    FrameSlot& slot = slots[frameIndex];
+
+    if (slot.submitted) {
+        readBack(slot);
+    }
+    slot.submitted = false;
+    slot.scopes.clear();
+    slot.openScopes.clear();
+    slot.statisticsCount = 0;
+
+    if (slot.timestampPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, slot.timestampPool, 0, MAX_SCOPES_PER_FRAME * 2);
+    }
+    if (slot.statisticsPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, slot.statisticsPool, 0, MAX_SCOPES_PER_FRAME);
+    }
+
+    recording = &slot;
+}
+
+void GpuProfiler::frameSubmitted(uint32_t frameIndex) {
+    slots[frameIndex].submitted = true;
+    recording = nullptr;
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name, bool executesSecondaries) {
+    // Past the budget the scope is dropped, endScope still pops it
+    if (recording == nullptr || !timestampsSupported || recording->scopes.size() >= MAX_SCOPES_PER_FRAME) {
+        if (recording != nullptr) {
+            recording->openScopes.push_back(UINT32_MAX);
+        }
+        return;
+    }
+
+    Scope scope;
+    scope.name = name;
+    scope.timestampQuery = static_cast<uint32_t>(recording->scopes.size()) * 2;
+    scope.statisticsQuery = UINT32_MAX;
+
+    // Statistics queries can't nest, and stay out of secondaries unless the device can inherit them
+    bool outermost = recording->openScopes.empty();
+    if (statisticsSupported && outermost && (!executesSecondaries || inheritedQueries)) {
+        scope.statisticsQuery = recording->statisticsCount++;
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, recording->timestampPool, scope.timestampQuery);
+    if (scope.statisticsQuery != UINT32_MAX) {
+        vkCmdBeginQuery(commandBuffer, recording->statisticsPool, scope.statisticsQuery, 0);
+    }
+
+    recording->openScopes.push_back(static_cast<uint32_t>(recording->scopes.size()));
+    recording->scopes.push_back(std::move(scope));
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer) {
+    if (recording == nullptr || recording->openScopes.empty()) {
+        return;
+    }
+
+    uint32_t index = recording->openScopes.back();
+    recording->openScopes.pop_back();
+    if (index == UINT32_MAX) {
+        return;
+    }
+
+    const Scope& scope = recording->scopes[index];
+    if (scope.statisticsQuery != UINT32_MAX) {
+        vkCmdEndQuery(commandBuffer, recording->statisticsPool, scope.statisticsQuery);
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, recording->timestampPool, scope.timestampQuery + 1);
+}
+
+void GpuProfiler::readBack(FrameSlot& slot) {
+    if (slot.scopes.empty()) {
+        return;
+    }
+
+    // No WAIT flag: the slot's frame retired before it came around again, anything not ready is skipped
+    std::vector<uint64_t> timestamps(slot.scopes.size() * 2);
+    VkResult timestampResult = vkGetQueryPoolResults(deviceService.device(), slot.timestampPool, 0,
+        static_cast<uint32_t>(timestamps.size()), timestamps.size() * sizeof(uint64_t), timestamps.data(),
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (timestampResult != VK_SUCCESS) {
+        return;
+    }
+
+    std::vector<PipelineStatistics> statistics(slot.statisticsCount);
+    bool statisticsReady = false;
+    if (slot.statisticsCount > 0) {
+        static_assert(sizeof(PipelineStatistics) == 7 * sizeof(uint64_t), "One uint64_t per STATISTICS_FLAGS bit");
+        statisticsReady = vkGetQueryPoolResults(deviceService.device(), slot.statisticsPool, 0, slot.statisticsCount,
+            statistics.size() * sizeof(PipelineStatistics), statistics.data(),
+            sizeof(PipelineStatistics), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+    }
+
+    // While tracing, put the scopes on the CPU timeline too (needs VK_EXT_calibrated_timestamps)
+    uint64_t calibrationTimestamp = 0;
+    uint64_t calibrationHostNs = 0;
+    bool trace = Tracer::get().isCapturing() && deviceService.getCalibratedTimestamps(calibrationTimestamp, calibrationHostNs);
+    calibrationTimestamp &= timestampMask;
+    auto toHostNs = [&](uint64_t timestamp) {
+        double ticks = static_cast<double>(timestamp) - static_cast<double>(calibrationTimestamp);
+        return static_cast<uint64_t>(static_cast<double>(calibrationHostNs) + ticks * timestampPeriod);
+    };
+
+    for (const Scope& scope : slot.scopes) {
+        uint64_t begin = timestamps[scope.timestampQuery] & timestampMask;
+        uint64_t end = timestamps[scope.timestampQuery + 1] & timestampMask;
+        double milliseconds = end > begin ? static_cast<double>(end - begin) * timestampPeriod / 1e6 : 0.0;
+
+        if (trace && end > begin) {
+            Tracer::get().recordGpu(scope.name, toHostNs(begin), toHostNs(end));
+        }
+
+        const PipelineStatistics* scopeStatistics = nullptr;
+        if (statisticsReady && scope.statisticsQuery != UINT32_MAX) {
+            scopeStatistics = &statistics[scope.statisticsQuery];
+        }
+        record(scope.name, milliseconds, scopeStatistics);
+    }
+}
+
+void GpuProfiler::record(const std::string& name, double milliseconds, const PipelineStatistics* statistics) {
+    auto [it, inserted] = history.try_emplace(name);
+    if (inserted) {
+        scopeOrder.push_back(name);
+    }
+
+    ScopeHistory& scope = it->second;
+    if (scope.samples.size() < HISTORY_SIZE) {
+        scope.samples.push_back(milliseconds);
+    } else {
+        scope.samples[scope.next] = milliseconds;
+    }
+    scope.next = (scope.next + 1) % HISTORY_SIZE;
+
+    if (statistics != nullptr) {
+        scope.hasStatistics = true;
+        scope.statistics = *statistics;
+    }
+}
+
+std::vector<GpuScopeStats> GpuProfiler::getScopeStats() const {
+    std::vector<GpuScopeStats> result;
+    result.reserve(scopeOrder.size());
+
+    for (const std::string& name : scopeOrder) {
+        const ScopeHistory& scope = history.at(name);
+
+        GpuScopeStats stats;
+        stats.name = name;
+        stats.samples = scope.samples.size();
+        stats.hasStatistics = scope.hasStatistics;
+        stats.statistics = scope.statistics;
+
+        std::vector<double> sorted = scope.samples;
+        std::sort(sorted.begin(), sorted.end());
+
+        double total = 0.0;
+        for (double sample : sorted) {
+            total += sample;
+        }
+        stats.minMs = sorted.front();
+        stats.avgMs = total / sorted.size();
+        stats.p99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void GpuProfiler::printReport() const {
+    std::cout << "\nGPU profile (last " << HISTORY_SIZE << " frames)" << std::endl;
+    if (!timestampsSupported) {
+        std::cout << "  Timestamps are not supported on the graphics queue" << std::endl;
+        return;
+    }
+
+    // Put back afterwards, so the fixed precision doesn't stick to std::cout
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+
+    for (const GpuScopeStats& stats : getScopeStats()) {
+        std::cout << "  " << std::left << std::setw(16) << stats.name << std::right << std::fixed << std::setprecision(3)
+                  << " min " << stats.minMs << "ms | avg " << stats.avgMs << "ms | p99 " << stats.p99Ms << "ms" << std::endl;
+        if (stats.hasStatistics) {
+            const PipelineStatistics& s = stats.statistics;
+            std::cout << "    vertices " << s.inputAssemblyVertices << " | primitives " << s.inputAssemblyPrimitives
+                      << " | VS " << s.vertexShaderInvocations << " | clipped " << s.clippingInvocations << " -> " << s.clippingPrimitives
+                      << " | FS " << s.fragmentShaderInvocations << " | CS " << s.computeShaderInvocations << std::endl;
+        }
+    }
+
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "../include/MemoryBudget.h"
+#include "../include/DeviceService.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+const char* memoryCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::Mesh: return "mesh";
+        case MemoryCategory::Uniform: return "uniform";
+        case MemoryCategory::Depth: return "depth";
+        case MemoryCategory::Staging: return "staging";
+        case MemoryCategory::RenderTarget: return "render_target";
+        case MemoryCategory::Culling: return "culling";
+        case MemoryCategory::Other: return "other";
+        case MemoryCategory::Count: break;
+    }
+    return "unknown";
+}
+
+MemoryBudget::MemoryBudget(DeviceService& device) : deviceService(device) {}
+
+void MemoryBudget::track(VmaAllocation allocation, MemoryCategory category) {
+    VmaAllocator allocator = deviceService.getAllocator();
+
+    // Stored + 1 so a null user data means untracked
+    vmaSetAllocationUserData(allocator, allocation, reinterpret_cast<void*>(static_cast<uintptr_t>(category) + 1));
+    vmaSetAllocationName(allocator, allocation, memoryCategoryName(category));
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+    categoryBytes[static_cast<size_t>(category)].fetch_add(info.size, std::memory_order_relaxed);
+}
+
+void MemoryBudget::untrack(VmaAllocation allocation) {
+    if (allocation == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(deviceService.getAllocator(), allocation, &info);
+    if (info.pUserData == nullptr) {
+        return;
+    }
+
+    size_t category = reinterpret_cast<uintptr_t>(info.pUserData) - 1;
+    categoryBytes[category].fetch_sub(info.size, std::memory_order_relaxed);
+}
+
+void MemoryBudget::update(uint32_t frameIndex) {
+    VmaAllocator allocator = deviceService.getAllocator();
+    vmaSetCurrentFrameIndex(allocator, frameIndex);
+
+    if (heapBudgets.empty()) {
+        const VkPhysicalDeviceMemoryProperties* properties;
+        vmaGetMemoryProperties(allocator, &properties);
+        heapBudgets.resize(properties->memoryHeapCount);
+        heapWarned.resize(properties->memoryHeapCount, false);
+        for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+            heapFlags.push_back(properties->memoryHeaps[i].flags);
+        }
+    }
+
+    // Cheap with the extension: VMA only re-queries the driver every few dozen allocations
+    vmaGetHeapBudgets(allocator, heapBudgets.data());
+
+    for (size_t i = 0; i < heapBudgets.size(); i++) {
+        const VmaBudget& budget = heapBudgets[i];
+        bool over = budget.budget > 0 && static_cast<double>(budget.usage) > static_cast<double>(budget.budget) * WARNING_FRACTION;
+        if (over && !heapWarned[i]) {
+            std::cerr << "\nMemory heap " << i << ((heapFlags[i] & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "")
+                      << " is at " << budget.usage / (1024 * 1024) << " of " << budget.budget / (1024 * 1024) << "MB budget" << std::endl;
+        }
+        heapWarned[i] = over;
+    }
+}
+
+VkDeviceSize MemoryBudget::getCategoryBytes(MemoryCategory category) const {
+    return categoryBytes[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+}
+
+double MemoryBudget::getHighestHeapFraction() const {
+    double highest = 0.0;
+    for (const VmaBudget& budget : heapBudgets) {
+        if (budget.budget > 0) {
+            highest = std::max(highest, static_cast<double>(budget.usage) / static_cast<double>(budget.budget));
+        }
+    }
+    return highest;
+}
+
+bool MemoryBudget::dumpStats(const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open memory stats file " << path << std::endl;
+        return false;
+    }
+
+    char* stats = nullptr;
+    vmaBuildStatsString(deviceService.getAllocator(), &stats, VK_TRUE);
+    file << stats;
+    vmaFreeStatsString(deviceService.getAllocator(), stats);
+
+    std::cout << "Memory stats written to " << path << std::endl;
+    return true;
+}
+
+void MemoryBudget::printReport() const {
+    // Formatted on its own stream, so the fixed precision doesn't stick to std::cout
+    std::ostringstream report;
+    report << "\nGPU memory (" << (deviceService.supportsMemoryBudget() ? "VK_EXT_memory_budget" : "estimated budget") << ")\n";
+
+    report << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < heapBudgets.size(); i++) {
+        const VmaBudget& budget = heapBudgets[i];
+        report << "  Heap " << i << ((heapFlags[i] & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "")
+               << ": usage " << budget.usage / (1024.0 * 1024.0) << "MB of " << budget.budget / (1024.0 * 1024.0) << "MB budget"
+               << " | VMA blocks " << budget.statistics.blockBytes / (1024.0 * 1024.0) << "MB"
+               << ", allocations " << budget.statistics.allocationBytes / (1024.0 * 1024.0) << "MB\n";
+    }
+
+    for (size_t i = 0; i < categoryBytes.size(); i++) {
+        MemoryCategory category = static_cast<MemoryCategory>(i);
+        report << "  " << std::left << std::setw(14) << memoryCategoryName(category) << std::right
+               << getCategoryBytes(category) / (1024.0 * 1024.0) << "MB\n";
+    }
+
+    std::cout << report.str() << std::flush;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "../include/OffsetAllocator.h"
+#include <stdexcept>
+
+OffsetAllocator::OffsetAllocator(uint64_t cap) : capacity(cap) {
+    if (capacity > 0) {
+        insertFreeBlock(0, capacity);
+    }
+}
+
+std::optional<uint64_t> OffsetAllocator::allocate(uint64_t size) {
+    if (size == 0) {
+        return std::nullopt;
+    }
+
+    // Smallest free block that still fits
+    auto fit = freeBySize.lower_bound(size);
+    if (fit == freeBySize.end()) {
+        return std::nullopt;
+    }
+
+    uint64_t blockSize = fit->first;
+    uint64_t offset = fit->second;
+    eraseFreeBlock(freeByOffset.find(offset));
+
+    if (blockSize > size) {
+        insertFreeBlock(offset + size, blockSize - size);
+    }
+
+    used += size;
+    return offset;
+}
+
+void OffsetAllocator::free(uint64_t offset, uint64_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (offset + size > capacity || size > used) {
+        throw std::runtime_error("OffsetAllocator: freeing a range that was never allocated!");
+    }
+    used -= size;
+
+    // Merge with the following block
+    auto next = freeByOffset.find(offset + size);
+    if (next != freeByOffset.end()) {
+        size += next->second;
+        eraseFreeBlock(next);
+    }
+
+    // Merge with the preceding block
+    auto prev = freeByOffset.lower_bound(offset);
+    if (prev != freeByOffset.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            eraseFreeBlock(prev);
+        }
+    }
+
+    insertFreeBlock(offset, size);
+}
+
+void OffsetAllocator::insertFreeBlock(uint64_t offset, uint64_t size) {
+    freeByOffset.emplace(offset, size);
+    freeBySize.emplace(size, offset);
+}
+
+void OffsetAllocator::eraseFreeBlock(std::map<uint64_t, uint64_t>::iterator block) {
+    auto range = freeBySize.equal_range(block->second);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == block->first) {
+            freeBySize.erase(it);
+            break;
+        }
+    }
+    freeByOffset.erase(block);
+}
\ No newline at end of file
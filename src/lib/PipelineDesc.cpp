@@ -0,0 +1,105 @@
+#include "../include/PipelineDesc.h"
+#include "../include/Vertex.h"
+#include "../include/HashCombine.h"
+#include <functional>
+
+PipelineDesc PipelineDesc::opaque(const std::string& vertPath, const std::string& fragPath, const std::string& indirectVertPath,
+    const std::string& bindlessVertPath) {
+    PipelineDesc desc;
+    desc.vertPath = vertPath;
+    desc.fragPath = fragPath;
+    desc.indirectVertPath = indirectVertPath;
+    desc.bindlessVertPath = bindlessVertPath;
+
+    desc.vertexBindings = {Vertex::getBindingDescription()};
+    auto attributes = Vertex::getAttributeDescriptions();
+    desc.vertexAttributes.assign(attributes.begin(), attributes.end());
+
+    return desc;
+}
+
+static bool operator==(const SpecializationConstant& a, const SpecializationConstant& b) {
+    return a.stages == b.stages && a.id == b.id && a.value == b.value;
+}
+
+static bool operator==(const VkVertexInputBindingDescription& a, const VkVertexInputBindingDescription& b) {
+    return a.binding == b.binding && a.stride == b.stride && a.inputRate == b.inputRate;
+}
+
+static bool operator==(const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
+    return a.location == b.location && a.binding == b.binding && a.format == b.format && a.offset == b.offset;
+}
+
+bool PipelineDesc::operator==(const PipelineDesc& other) const {
+    return vertPath == other.vertPath &&
+           fragPath == other.fragPath &&
+           indirectVertPath == other.indirectVertPath &&
+           bindlessVertPath == other.bindlessVertPath &&
+           specializationConstants == other.specializationConstants &&
+           vertexBindings == other.vertexBindings &&
+           vertexAttributes == other.vertexAttributes &&
+           topology == other.topology &&
+           polygonMode == other.polygonMode &&
+           cullMode == other.cullMode &&
+           frontFace == other.frontFace &&
+           depthTest == other.depthTest &&
+           depthWrite == other.depthWrite &&
+           depthCompareOp == other.depthCompareOp &&
+           blendEnable == other.blendEnable &&
+           srcColorBlendFactor == other.srcColorBlendFactor &&
+           dstColorBlendFactor == other.dstColorBlendFactor &&
+           colorBlendOp == other.colorBlendOp &&
+           srcAlphaBlendFactor == other.srcAlphaBlendFactor &&
+           dstAlphaBlendFactor == other.dstAlphaBlendFactor &&
+           alphaBlendOp == other.alphaBlendOp &&
+           colorWriteMask == other.colorWriteMask &&
+           subpass == other.subpass &&
+           samples == other.samples;
+}
+
+size_t PipelineDescHash::operator()(const PipelineDesc& desc) const {
+    size_t seed = 0;
+    std::hash<std::string> hashString;
+
+    hashCombine(seed, hashString(desc.vertPath));
+    hashCombine(seed, hashString(desc.fragPath));
+    hashCombine(seed, hashString(desc.indirectVertPath));
+    hashCombine(seed, hashString(desc.bindlessVertPath));
+
+    for (const auto& constant : desc.specializationConstants) {
+        hashCombine(seed, constant.stages);
+        hashCombine(seed, constant.id);
+        hashCombine(seed, constant.value);
+    }
+    for (const auto& binding : desc.vertexBindings) {
+        hashCombine(seed, binding.binding);
+        hashCombine(seed, binding.stride);
+        hashCombine(seed, binding.inputRate);
+    }
+    for (const auto& attribute : desc.vertexAttributes) {
+        hashCombine(seed, attribute.location);
+        hashCombine(seed, attribute.binding);
+        hashCombine(seed, attribute.format);
+        hashCombine(seed, attribute.offset);
+    }
+
+    hashCombine(seed, desc.topology);
+    hashCombine(seed, desc.polygonMode);
+    hashCombine(seed, desc.cullMode);
+    hashCombine(seed, desc.frontFace);
+    hashCombine(seed, desc.depthTest);
+    hashCombine(seed, desc.depthWrite);
+    hashCombine(seed, desc.depthCompareOp);
+    hashCombine(seed, desc.blendEnable);
+    hashCombine(seed, desc.srcColorBlendFactor);
+    hashCombine(seed, desc.dstColorBlendFactor);
+    hashCombine(seed, desc.colorBlendOp);
+    hashCombine(seed, desc.srcAlphaBlendFactor);
+    hashCombine(seed, desc.dstAlphaBlendFactor);
+    hashCombine(seed, desc.alphaBlendOp);
+    hashCombine(seed, desc.colorWriteMask);
+    hashCombine(seed, desc.subpass);
+    hashCombine(seed, desc.samples);
+
+    return seed;
+}
\ No newline at end of file
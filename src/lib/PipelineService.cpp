@@ -1,41 +1,166 @@
 #include "../include/PipelineService.h"
+#include "../include/Tracer.h"
 #include "../include/BufferService.h"
+#include "../include/CullingService.h"
+#include "../include/BindlessRegistry.h"
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 
-PipelineService::PipelineService(DeviceService& device, SwapChainService& swapChain)
-    : deviceService(device), swapChainService(swapChain) {
-    
+PipelineService::PipelineService(DeviceService& device, SwapChainService& swapChain, const std::string& cachePath, bool preferDynamicRendering)
+    : deviceService(device), swapChainService(swapChain), pipelineCachePath(cachePath),
+      dynamicRendering(preferDynamicRendering && device.supportsDynamicRendering()) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    createPipelineCache();
     createRenderPass();
     createDescriptorSetLayout();
+    createBindlessSetLayout();
+    createPipelineLayouts();
     createGraphicsPipeline();
+    createCullPipeline();
     createFramebuffers();     
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Pipelines built in " << std::chrono::duration<double, std::milli>(endTime - startTime).count()
+              << "ms (pipeline cache " << (pipelineCacheWarm ? "warm" : "cold") << ")" << std::endl;
 }
 
 PipelineService::~PipelineService() {
+    waitForPipelines();
+    pollPipelines();
+    destroyRequestedPipelines();
+
+    savePipelineCache();
+    vkDestroyPipelineCache(deviceService.device(), pipelineCache, nullptr);
+
     for (auto framebuffer : swapChainFramebuffers) {
         vkDestroyFramebuffer(deviceService.device(), framebuffer, nullptr);
     }
-    vkDestroyPipeline(deviceService.device(), graphicsPipeline, nullptr);
+    vkDestroyPipeline(deviceService.device(), cullPipeline, nullptr);
+    vkDestroyPipelineLayout(deviceService.device(), cullPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(deviceService.device(), indirectPipelineLayout, nullptr);
+    if (bindlessPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(deviceService.device(), bindlessPipelineLayout, nullptr);
+    }
     vkDestroyPipelineLayout(deviceService.device(), pipelineLayout, nullptr);
     vkDestroyRenderPass(deviceService.device(), renderPass, nullptr);
-    vkDestroyDescriptorSetLayout(deviceService.device(), descriptorSetLayout, nullptr);
+    // The set layouts belong to the descriptor allocator's cache
+}
+
+void PipelineService::createPipelineCache() {
+    std::vector<char> data;
+    std::ifstream file(pipelineCachePath, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        data.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(data.data(), data.size());
+    }
+
+    // A cache from another GPU or driver is useless at best, so start cold instead
+    if (!data.empty() && !isPipelineCacheCompatible(data)) {
+        std::cout << "Pipeline cache " << pipelineCachePath << " is from another device or driver, ignoring it" << std::endl;
+        data.clear();
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(deviceService.device(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache!");
+    }
+
+    pipelineCacheWarm = !data.empty();
+    savedPipelineCacheSize = data.size();
+}
+
+bool PipelineService::isPipelineCacheCompatible(const std::vector<char>& data) {
+    if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(deviceService.physicalDevice(), &properties);
+
+    return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineService::savePipelineCache() {
+    AURELIUS_TRACE("PipelineService::savePipelineCache");
+    size_t size = 0;
+    if (vkGetPipelineCacheData(deviceService.device(), pipelineCache, &size, nullptr) != VK_SUCCESS) {
+        return;
+    }
+
+    // The cache only ever grows, so an unchanged size means nothing new to write
+    if (size == 0 || size == savedPipelineCacheSize) {
+        return;
+    }
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(deviceService.device(), pipelineCache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Write next to the real file and rename over it, a crash mid-write never leaves a torn cache behind
+    std::string tempPath = pipelineCachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Failed to write pipeline cache: " << tempPath << std::endl;
+            return;
+        }
+        file.write(data.data(), size);
+        if (!file) {
+            std::cout << "Failed to write pipeline cache: " << tempPath << std::endl;
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, pipelineCachePath, error);
+    if (error) {
+        std::cout << "Failed to replace pipeline cache: " << error.message() << std::endl;
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+
+    savedPipelineCacheSize = size;
 }
 
 void PipelineService::createRenderPass() {
+    colorFormat = swapChainService.getSwapChainImageFormat();
+    depthFormat = swapChainService.findDepthFormat();
+
+    // Pipelines only need the formats
+    if (dynamicRendering) {
+        return;
+    }
+
     VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = swapChainService.getSwapChainImageFormat(); // Ask SwapChain for format
+    colorAttachment.format = colorFormat; // Ask SwapChain for format
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;   // Clear screen to black
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Keep contents
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Ready for display
+    colorAttachment.finalLayout = swapChainService.getFinalLayout(); // Ready for display (or readback when headless)
 
     VkAttachmentDescription depthAttachment{};
-    depthAttachment.format = swapChainService.findDepthFormat(); // Make sure to make this public in SwapChainService!
+    depthAttachment.format = depthFormat;
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // Clear depth at start of frame
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -48,16 +173,21 @@ void PipelineService::createRenderPass() {
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT; // Previous frame's depth writes
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
@@ -77,6 +207,9 @@ void PipelineService::createRenderPass() {
 }
 
 void PipelineService::createDescriptorSetLayout() {
+    // Cached by signature, anyone else asking for the same bindings gets these very layouts back
+    DescriptorAllocator& descriptorAllocator = deviceService.getDescriptorAllocator();
+
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
     uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -84,19 +217,327 @@ void PipelineService::createDescriptorSetLayout() {
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
 
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    descriptorSetLayout = descriptorAllocator.getLayout({uboLayoutBinding});
+
+    // Object buffer the GPU-driven vertex shader reads its transform from
+    VkDescriptorSetLayoutBinding objectBinding{};
+    objectBinding.binding = 0;
+    objectBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    objectBinding.descriptorCount = 1;
+    objectBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    objectSetLayout = descriptorAllocator.getLayout({objectBinding});
+
+    // Per-object data out of CommandService's ring, bound once per command buffer at the frame's dynamic offset
+    VkDescriptorSetLayoutBinding objectDataBinding{};
+    objectDataBinding.binding = 0;
+    objectDataBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    objectDataBinding.descriptorCount = 1;
+    objectDataBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    objectDataSetLayout = descriptorAllocator.getLayout({objectDataBinding});
+
+    // Culling pass: objects in, draw commands and per-batch counts out
+    std::vector<VkDescriptorSetLayoutBinding> cullBindings(3);
+    for (uint32_t i = 0; i < cullBindings.size(); i++) {
+        cullBindings[i].binding = i;
+        cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
 
-    if (vkCreateDescriptorSetLayout(deviceService.device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create descriptor set layout!");
+    cullSetLayout = descriptorAllocator.getLayout(cullBindings);
+}
+
+void PipelineService::createBindlessSetLayout() {
+    if (!deviceService.supportsBindless()) {
+        return;
+    }
+
+    // Clamp to what the device allows per stage, then shrink everything evenly if the total is still over
+    // the per-stage resource limit (with room left for set 0)
+    const BindlessLimits& limits = deviceService.getBindlessLimits();
+    bindlessCapacities = {
+        std::min(DEFAULT_BINDLESS_STORAGE_BUFFERS, limits.storageBuffers),
+        std::min(DEFAULT_BINDLESS_SAMPLED_IMAGES, limits.sampledImages),
+        std::min(DEFAULT_BINDLESS_SAMPLERS, limits.samplers)
+    };
+
+    uint64_t total = uint64_t(bindlessCapacities[0]) + bindlessCapacities[1] + bindlessCapacities[2];
+    uint64_t available = limits.resources > 16 ? limits.resources - 16 : 0;
+    if (total > available) {
+        for (uint32_t& capacity : bindlessCapacities) {
+            capacity = static_cast<uint32_t>(capacity * available / total);
+        }
+    }
+
+    std::array<VkDescriptorType, 3> types = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLER};
+    std::vector<VkDescriptorSetLayoutBinding> bindings(3);
+    std::vector<VkDescriptorBindingFlags> bindingFlags(3);
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = types[i];
+        bindings[i].descriptorCount = bindlessCapacities[i];
+        // Only the graphics pipelines use the set: textures are sampled in the fragment shader, and the storage
+        // buffers (object data) are read by the vertex shader too, see below
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        // Slots are written while frames using the set are in flight, and most of them are never written at all
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    }
+    bindings[static_cast<uint32_t>(BindlessBinding::StorageBuffers)].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+    bindlessSetLayout = deviceService.getDescriptorAllocator().getLayout(bindings, bindingFlags, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT);
+}
+
+uint32_t PipelineService::getBindlessCapacity(BindlessBinding binding) const {
+    return bindlessCapacities[static_cast<size_t>(binding)];
+}
+
+void PipelineService::createPipelineLayouts() {
+    // Set 0 is the frame constants, set 1 the frame's object data
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {descriptorSetLayout, objectDataSetLayout};
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+
+    // Per-draw index into the object data, the only thing that changes between draws
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawConstants);
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(deviceService.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout!");
+    }
+
+    // Indirect draws: same set 0, transforms come from the object buffer in set 1
+    std::array<VkDescriptorSetLayout, 2> indirectSetLayouts = {descriptorSetLayout, objectSetLayout};
+
+    VkPipelineLayoutCreateInfo indirectLayoutInfo{};
+    indirectLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    indirectLayoutInfo.setLayoutCount = static_cast<uint32_t>(indirectSetLayouts.size());
+    indirectLayoutInfo.pSetLayouts = indirectSetLayouts.data();
+
+    if (vkCreatePipelineLayout(deviceService.device(), &indirectLayoutInfo, nullptr, &indirectPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create indirect pipeline layout!");
+    }
+
+    // Bindless draws: same set 0, everything else through the global set 1 and the slots in the push constants
+    if (bindlessSetLayout != VK_NULL_HANDLE) {
+        std::array<VkDescriptorSetLayout, 2> bindlessSetLayouts = {descriptorSetLayout, bindlessSetLayout};
+
+        VkPushConstantRange bindlessPushConstantRange{};
+        bindlessPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindlessPushConstantRange.offset = 0;
+        bindlessPushConstantRange.size = sizeof(BindlessConstants);
+
+        VkPipelineLayoutCreateInfo bindlessLayoutInfo{};
+        bindlessLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        bindlessLayoutInfo.setLayoutCount = static_cast<uint32_t>(bindlessSetLayouts.size());
+        bindlessLayoutInfo.pSetLayouts = bindlessSetLayouts.data();
+        bindlessLayoutInfo.pushConstantRangeCount = 1;
+        bindlessLayoutInfo.pPushConstantRanges = &bindlessPushConstantRange;
+
+        if (vkCreatePipelineLayout(deviceService.device(), &bindlessLayoutInfo, nullptr, &bindlessPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create bindless pipeline layout!");
+        }
+    }
+
+    VkPushConstantRange cullPushConstantRange{};
+    cullPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullPushConstantRange.offset = 0;
+    cullPushConstantRange.size = sizeof(CullConstants);
+
+    VkPipelineLayoutCreateInfo cullLayoutInfo{};
+    cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    cullLayoutInfo.setLayoutCount = 1;
+    cullLayoutInfo.pSetLayouts = &cullSetLayout;
+    cullLayoutInfo.pushConstantRangeCount = 1;
+    cullLayoutInfo.pPushConstantRanges = &cullPushConstantRange;
+
+    if (vkCreatePipelineLayout(deviceService.device(), &cullLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cull pipeline layout!");
     }
 }
 
 void PipelineService::createGraphicsPipeline() {
-    auto vertShaderCode = readFile("shaders/vert.spv");
-    auto fragShaderCode = readFile("shaders/frag.spv");
+    // The default pipeline is registered like any other desc, so requesting it again dedupes to handle 0
+    if (pipelineSlots.empty()) {
+        PipelineDesc desc = PipelineDesc::opaque("shaders/vert.spv", "shaders/frag.spv", "shaders/vert_indirect.spv", "shaders/vert_bindless.spv");
+        pipelineRegistry.emplace(desc, DEFAULT_PIPELINE.index);
+        pipelineSlots.push_back({desc});
+    }
+
+    PipelineSlot& slot = pipelineSlots[DEFAULT_PIPELINE.index];
+    slot.pipeline = buildGraphicsPipeline(slot.desc, PipelineVariant::Standard);
+    slot.indirectPipeline = buildGraphicsPipeline(slot.desc, PipelineVariant::Indirect);
+    indirectVariants[slot.pipeline] = slot.indirectPipeline;
+    if (bindlessPipelineLayout != VK_NULL_HANDLE) {
+        slot.bindlessPipeline = buildGraphicsPipeline(slot.desc, PipelineVariant::Bindless);
+        bindlessVariants[slot.pipeline] = slot.bindlessPipeline;
+    }
+}
+
+PipelineHandle PipelineService::requestPipeline(const PipelineDesc& desc) {
+    auto it = pipelineRegistry.find(desc);
+    if (it != pipelineRegistry.end()) {
+        return {it->second};
+    }
+
+    uint32_t index = static_cast<uint32_t>(pipelineSlots.size());
+    pipelineRegistry.emplace(desc, index);
+    pipelineSlots.push_back({desc});
+    submitCompile(index);
+    return {index};
+}
+
+void PipelineService::submitCompile(uint32_t index) {
+    {
+        std::lock_guard<std::mutex> lock(compileMutex);
+        pendingCompiles++;
+    }
+
+    // The job gets its own copy of the desc, pipelineSlots may grow while it runs
+    compilePool.submit([this, index, desc = pipelineSlots[index].desc]() {
+        AURELIUS_TRACE("PipelineService::compile");
+        CompileResult result{index, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE};
+        try {
+            result.pipeline = buildGraphicsPipeline(desc, PipelineVariant::Standard);
+            if (!desc.indirectVertPath.empty()) {
+                result.indirectPipeline = buildGraphicsPipeline(desc, PipelineVariant::Indirect);
+            }
+            if (!desc.bindlessVertPath.empty() && bindlessPipelineLayout != VK_NULL_HANDLE) {
+                result.bindlessPipeline = buildGraphicsPipeline(desc, PipelineVariant::Bindless);
+            }
+        } catch (const std::exception& e) {
+            // Draws keep using the fallback
+            std::cerr << "Pipeline compile failed (" << desc.vertPath << ", " << desc.fragPath << "): " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(compileMutex);
+        completedCompiles.push_back(result);
+        pendingCompiles--;
+        compileFinished.notify_all();
+    });
+}
+
+std::vector<PipelineHandle> PipelineService::prewarm(const std::vector<PipelineDesc>& descs) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<PipelineHandle> handles;
+    handles.reserve(descs.size());
+    for (const auto& desc : descs) {
+        handles.push_back(requestPipeline(desc));
+    }
+
+    waitForPipelines();
+    pollPipelines();
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Prewarmed " << descs.size() << " pipelines in " << std::chrono::duration<double, std::milli>(endTime - startTime).count()
+              << "ms (pipeline cache " << (pipelineCacheWarm ? "warm" : "cold") << ")" << std::endl;
+
+    return handles;
+}
+
+void PipelineService::waitForPipelines() {
+    std::unique_lock<std::mutex> lock(compileMutex);
+    compileFinished.wait(lock, [this]() { return pendingCompiles == 0; });
+}
+
+void PipelineService::pollPipelines() {
+    AURELIUS_TRACE("PipelineService::pollPipelines");
+    std::vector<CompileResult> results;
+    {
+        std::lock_guard<std::mutex> lock(compileMutex);
+        if (completedCompiles.empty()) {
+            return;
+        }
+        results.swap(completedCompiles);
+    }
+
+    for (const CompileResult& result : results) {
+        PipelineSlot& slot = pipelineSlots[result.index];
+        slot.pipeline = result.pipeline;
+        slot.indirectPipeline = result.indirectPipeline;
+        slot.bindlessPipeline = result.bindlessPipeline;
+
+        if (slot.pipeline != VK_NULL_HANDLE && slot.indirectPipeline != VK_NULL_HANDLE) {
+            indirectVariants[slot.pipeline] = slot.indirectPipeline;
+        }
+        if (slot.pipeline != VK_NULL_HANDLE && slot.bindlessPipeline != VK_NULL_HANDLE) {
+            bindlessVariants[slot.pipeline] = slot.bindlessPipeline;
+        }
+    }
+}
+
+VkPipeline PipelineService::resolvePipeline(PipelineHandle handle) {
+    VkPipeline pipeline = pipelineSlots[handle.index].pipeline;
+    return pipeline != VK_NULL_HANDLE ? pipeline : getPipeline();
+}
+
+VkPipeline PipelineService::getIndirectVariant(VkPipeline pipeline) {
+    auto it = indirectVariants.find(pipeline);
+    return it != indirectVariants.end() ? it->second : VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineService::getBindlessVariant(VkPipeline pipeline) {
+    auto it = bindlessVariants.find(pipeline);
+    return it != bindlessVariants.end() ? it->second : VK_NULL_HANDLE;
+}
+
+void PipelineService::destroyRequestedPipelines() {
+    // Frames in flight may still be bound to them
+    DeletionQueue& deletionQueue = deviceService.getDeletionQueue();
+    for (PipelineSlot& slot : pipelineSlots) {
+        if (slot.pipeline != VK_NULL_HANDLE) {
+            indirectVariants.erase(slot.pipeline);
+            bindlessVariants.erase(slot.pipeline);
+            deletionQueue.destroyPipeline(slot.pipeline);
+        }
+        if (slot.indirectPipeline != VK_NULL_HANDLE) {
+            deletionQueue.destroyPipeline(slot.indirectPipeline);
+        }
+        if (slot.bindlessPipeline != VK_NULL_HANDLE) {
+            deletionQueue.destroyPipeline(slot.bindlessPipeline);
+        }
+        slot.pipeline = VK_NULL_HANDLE;
+        slot.indirectPipeline = VK_NULL_HANDLE;
+        slot.bindlessPipeline = VK_NULL_HANDLE;
+    }
+}
+
+void PipelineService::createCullPipeline() {
+    VkShaderModule cullShaderModule = createShaderModule(readFile("shaders/cull.spv"));
+
+    VkPipelineShaderStageCreateInfo stageInfo{};
+    stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stageInfo.module = cullShaderModule;
+    stageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = stageInfo;
+    pipelineInfo.layout = cullPipelineLayout;
+
+    if (vkCreateComputePipelines(deviceService.device(), pipelineCache, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cull pipeline!");
+    }
+
+    vkDestroyShaderModule(deviceService.device(), cullShaderModule, nullptr);
+}
+
+VkPipeline PipelineService::buildGraphicsPipeline(const PipelineDesc& desc, PipelineVariant variant) {
+    const std::string& vertPath = variant == PipelineVariant::Indirect ? desc.indirectVertPath :
+                                  variant == PipelineVariant::Bindless ? desc.bindlessVertPath : desc.vertPath;
+    auto vertShaderCode = readFile(vertPath);
+    auto fragShaderCode = readFile(desc.fragPath);
 
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
     VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -107,28 +548,56 @@ void PipelineService::createGraphicsPipeline() {
     vertShaderStageInfo.module = vertShaderModule;
     vertShaderStageInfo.pName = "main";
 
+    // Specialization constants, split per stage
+    std::vector<VkSpecializationMapEntry> vertEntries;
+    std::vector<VkSpecializationMapEntry> fragEntries;
+    std::vector<uint32_t> vertData;
+    std::vector<uint32_t> fragData;
+    for (const auto& constant : desc.specializationConstants) {
+        if (constant.stages & VK_SHADER_STAGE_VERTEX_BIT) {
+            vertEntries.push_back({constant.id, static_cast<uint32_t>(vertData.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+            vertData.push_back(constant.value);
+        }
+        if (constant.stages & VK_SHADER_STAGE_FRAGMENT_BIT) {
+            fragEntries.push_back({constant.id, static_cast<uint32_t>(fragData.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+            fragData.push_back(constant.value);
+        }
+    }
+
+    VkSpecializationInfo vertSpecialization{};
+    vertSpecialization.mapEntryCount = static_cast<uint32_t>(vertEntries.size());
+    vertSpecialization.pMapEntries = vertEntries.data();
+    vertSpecialization.dataSize = vertData.size() * sizeof(uint32_t);
+    vertSpecialization.pData = vertData.data();
+
+    VkSpecializationInfo fragSpecialization{};
+    fragSpecialization.mapEntryCount = static_cast<uint32_t>(fragEntries.size());
+    fragSpecialization.pMapEntries = fragEntries.data();
+    fragSpecialization.dataSize = fragData.size() * sizeof(uint32_t);
+    fragSpecialization.pData = fragData.data();
+
+    vertShaderStageInfo.pSpecializationInfo = vertEntries.empty() ? nullptr : &vertSpecialization;
+
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = fragEntries.empty() ? nullptr : &fragSpecialization;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
     // Vertex Input 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertexBindings.size());
+    vertexInputInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertexAttributes.size());
+    vertexInputInfo.pVertexAttributeDescriptions = desc.vertexAttributes.data();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.topology = desc.topology;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
     // Dynamic Viewport State
@@ -141,20 +610,26 @@ void PipelineService::createGraphicsPipeline() {
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizer.depthClampEnable = VK_FALSE;
     rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.polygonMode = desc.polygonMode;
     rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.cullMode = desc.cullMode;
+    rasterizer.frontFace = desc.frontFace;
     rasterizer.depthBiasEnable = VK_FALSE;
 
     VkPipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.rasterizationSamples = desc.samples;
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
+    colorBlendAttachment.colorWriteMask = desc.colorWriteMask;
+    colorBlendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = desc.srcColorBlendFactor;
+    colorBlendAttachment.dstColorBlendFactor = desc.dstColorBlendFactor;
+    colorBlendAttachment.colorBlendOp = desc.colorBlendOp;
+    colorBlendAttachment.srcAlphaBlendFactor = desc.srcAlphaBlendFactor;
+    colorBlendAttachment.dstAlphaBlendFactor = desc.dstAlphaBlendFactor;
+    colorBlendAttachment.alphaBlendOp = desc.alphaBlendOp;
 
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -171,20 +646,11 @@ void PipelineService::createGraphicsPipeline() {
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    
-    if (vkCreatePipelineLayout(deviceService.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create pipeline layout!");
-    }
-
     VkPipelineDepthStencilStateCreateInfo depthStencil{};
     depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable = VK_TRUE;  // Check depth
-    depthStencil.depthWriteEnable = VK_TRUE; // Write new depth
-    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS; // Draw if closer
+    depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = desc.depthCompareOp;
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.stencilTestEnable = VK_FALSE;
 
@@ -200,19 +666,38 @@ void PipelineService::createGraphicsPipeline() {
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.pDepthStencilState = &depthStencil;
-    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.layout = variant == PipelineVariant::Indirect ? indirectPipelineLayout :
+                          variant == PipelineVariant::Bindless ? bindlessPipelineLayout : pipelineLayout;
     pipelineInfo.renderPass = renderPass;
-    pipelineInfo.subpass = 0;
+    pipelineInfo.subpass = desc.subpass;
+
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    if (dynamicRendering) {
+        pipelineInfo.pNext = &renderingInfo;
+        pipelineInfo.renderPass = VK_NULL_HANDLE;
+        pipelineInfo.subpass = 0;
+    }
 
-    if (vkCreateGraphicsPipelines(deviceService.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(deviceService.device(), pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create graphics pipeline!");
     }
 
     vkDestroyShaderModule(deviceService.device(), fragShaderModule, nullptr);
     vkDestroyShaderModule(deviceService.device(), vertShaderModule, nullptr);
+
+    return pipeline;
 }
 
 void PipelineService::createFramebuffers() {
+    if (dynamicRendering) {
+        return;
+    }
+
     size_t imageCount = swapChainService.getImageCount();
     swapChainFramebuffers.resize(imageCount);
 
@@ -238,9 +723,41 @@ void PipelineService::createFramebuffers() {
 }
 
 void PipelineService::recreateFramebuffers() {
+    AURELIUS_TRACE("PipelineService::recreateFramebuffers");
+    // The old framebuffers (and render pass below) go once the frames recorded against them retire
+    DeletionQueue& deletionQueue = deviceService.getDeletionQueue();
     for (auto framebuffer : swapChainFramebuffers) {
-        vkDestroyFramebuffer(deviceService.device(), framebuffer, nullptr);
+        deletionQueue.destroyFramebuffer(framebuffer);
     }
+    swapChainFramebuffers.clear();
+
+    // New surface format (monitor change, HDR toggle...): the render pass and every pipeline built against it are stale
+    if (swapChainService.getSwapChainImageFormat() != colorFormat) {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        // Nothing may still be compiling against the old render pass
+        waitForPipelines();
+        pollPipelines();
+        destroyRequestedPipelines();
+
+        if (renderPass != VK_NULL_HANDLE) {
+            deletionQueue.destroyRenderPass(renderPass);
+            renderPass = VK_NULL_HANDLE;
+        }
+
+        createRenderPass();
+        createGraphicsPipeline();
+
+        // Requested pipelines recompile in the background, their draws use the fallback meanwhile
+        for (uint32_t i = DEFAULT_PIPELINE.index + 1; i < pipelineSlots.size(); i++) {
+            submitCompile(i);
+        }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        std::cout << "Swapchain format changed, pipelines rebuilt in " << std::chrono::duration<double, std::milli>(endTime - startTime).count()
+                  << "ms (pipeline cache " << (pipelineCacheWarm ? "warm" : "cold") << ")" << std::endl;
+    }
+
     createFramebuffers();
 }
 
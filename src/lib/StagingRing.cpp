@@ -0,0 +1,126 @@
+#include "../include/StagingRing.h"
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+StagingRing::StagingRing(DeviceService& device, UploadService& upload, VkDeviceSize ringSize)
+    : deviceService(device), uploadService(upload), size(ringSize) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY; // Host coherent, no flushes needed
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo{};
+    if (vmaCreateBuffer(deviceService.getAllocator(), &bufferInfo, &allocInfo, &buffer, &allocation, &allocationInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create staging ring!");
+    }
+    deviceService.getMemoryBudget().track(allocation, MemoryCategory::Staging);
+    mapped = static_cast<char*>(allocationInfo.pMappedData);
+}
+
+StagingRing::~StagingRing() {
+    // The transfer queue may still be reading from the ring
+    uploadService.wait(uploadService.flush());
+    deviceService.getMemoryBudget().untrack(allocation);
+    vmaDestroyBuffer(deviceService.getAllocator(), buffer, allocation);
+}
+
+StagingAllocation StagingRing::allocate(VkDeviceSize requestSize, VkDeviceSize alignment) {
+    if (requestSize > size) {
+        return allocateSpill(requestSize);
+    }
+
+    retireCompletedRegions();
+
+    VkDeviceSize offset;
+    while (!tryAllocate(requestSize, alignment, offset)) {
+        // Ring is full: wait for the oldest batch (submitting it first if it is still open)
+        uploadService.wait({regions.front().timelineValue});
+        retireCompletedRegions();
+    }
+
+    uint64_t timelineValue = uploadService.pendingTicket().value;
+    VkDeviceSize end = offset + requestSize;
+
+    // Allocations of the same batch collapse into one region
+    if (!regions.empty() && regions.back().timelineValue == timelineValue && regions.back().end <= offset) {
+        regions.back().end = end;
+    } else {
+        regions.push_back({offset, end, timelineValue});
+    }
+    head = end;
+
+    return {buffer, offset, mapped + offset};
+}
+
+bool StagingRing::tryAllocate(VkDeviceSize requestSize, VkDeviceSize alignment, VkDeviceSize& offset) {
+    if (regions.empty()) {
+        head = 0;
+        offset = 0;
+        return true;
+    }
+
+    VkDeviceSize tail = regions.front().offset;
+    VkDeviceSize start = alignUp(head, alignment);
+
+    if (head > tail) {
+        // Live data is [tail, head): use the space up to the end, or wrap to the front
+        if (start + requestSize <= size) {
+            offset = start;
+            return true;
+        }
+        if (requestSize <= tail) {
+            offset = 0;
+            return true;
+        }
+        return false;
+    }
+
+    if (head < tail) {
+        // Wrapped: the only free space is [head, tail)
+        if (start + requestSize <= tail) {
+            offset = start;
+            return true;
+        }
+        return false;
+    }
+
+    // head == tail with live regions means the ring is full
+    return false;
+}
+
+void StagingRing::retireCompletedRegions() {
+    while (!regions.empty() && uploadService.isComplete({regions.front().timelineValue})) {
+        regions.pop_front();
+    }
+}
+
+StagingAllocation StagingRing::allocateSpill(VkDeviceSize requestSize) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = requestSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VkBuffer spillBuffer;
+    VmaAllocation spillAllocation;
+    VmaAllocationInfo allocationInfo{};
+    if (vmaCreateBuffer(deviceService.getAllocator(), &bufferInfo, &allocInfo, &spillBuffer, &spillAllocation, &allocationInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create staging spill buffer!");
+    }
+    deviceService.getMemoryBudget().track(spillAllocation, MemoryCategory::Staging);
+
+    uploadService.releaseAfterUpload(spillBuffer, spillAllocation);
+    return {spillBuffer, 0, allocationInfo.pMappedData};
+}
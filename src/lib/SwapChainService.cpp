@@ -1,13 +1,30 @@
 #include "../include/SwapChainService.h"
+#include "../include/Tracer.h"
 #include "../include/vk_mem_alloc.h"
 #include <stdexcept>
 #include <limits>
 #include <algorithm>
 #include <vector>
+#include <iostream>
+
+const char* presentPolicyName(PresentPolicy policy) {
+    switch (policy) {
+        case PresentPolicy::Vsync: return "vsync";
+        case PresentPolicy::VsyncRelaxed: return "relaxed";
+        case PresentPolicy::Mailbox: return "mailbox";
+        case PresentPolicy::Immediate: return "immediate";
+        case PresentPolicy::Capped: return "capped";
+    }
+    return "unknown";
+}
 
-SwapChainService::SwapChainService(DeviceService& device, WindowService& window) 
-    : deviceService(device), windowService(window) {
-    createSwapChain();
+SwapChainService::SwapChainService(DeviceService& device, WindowService& window, uint32_t imageCount, PresentPolicy policy)
+    : deviceService(device), windowService(window), headless(window.isHeadless()), requestedImageCount(imageCount), presentPolicy(policy) {
+    if (headless) {
+        createOffscreenImages();
+    } else {
+        createSwapChain();
+    }
     createImageViews();
     createDepthResources(); // <--- NEW: Create depth buffer at startup
 }
@@ -16,14 +33,16 @@ SwapChainService::~SwapChainService() {
     cleanupSwapChain();
 }
 
-void SwapChainService::createSwapChain() {
+void SwapChainService::createSwapChain(VkSwapchainKHR oldSwapChain) {
     SwapChainSupportDetails swapChainSupport = deviceService.getSwapChainSupport();
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+    VkPresentModeKHR chosenPresentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    // More images queue more frames ahead of the display (throughput), fewer cut latency
+    uint32_t imageCount = requestedImageCount != 0 ? requestedImageCount : swapChainSupport.capabilities.minImageCount + 1;
+    imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
@@ -51,9 +70,10 @@ void SwapChainService::createSwapChain() {
 
     createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode = presentMode;
+    createInfo.presentMode = chosenPresentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Lets the driver reuse resources and finish presenting what was already queued on the old one
+    createInfo.oldSwapchain = oldSwapChain;
 
     if (vkCreateSwapchainKHR(deviceService.device(), &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create swap chain!");
@@ -65,6 +85,34 @@ void SwapChainService::createSwapChain() {
 
     swapChainImageFormat = surfaceFormat.format;
     swapChainExtent = extent;
+
+    if (oldSwapChain == VK_NULL_HANDLE || chosenPresentMode != presentMode) {
+        std::cout << "Present policy " << presentPolicyName(presentPolicy) << ": " << imageCount << " images, "
+                  << (chosenPresentMode == VK_PRESENT_MODE_FIFO_KHR ? "FIFO" :
+                      chosenPresentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR ? "FIFO_RELAXED" :
+                      chosenPresentMode == VK_PRESENT_MODE_MAILBOX_KHR ? "MAILBOX" : "IMMEDIATE") << std::endl;
+    }
+    presentMode = chosenPresentMode;
+}
+
+void SwapChainService::createOffscreenImages() {
+    // Same format the windowed path prefers, so pipelines and shaders don't change
+    swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+    swapChainExtent = windowService.getExtent();
+
+    uint32_t imageCount = std::max(requestedImageCount, HEADLESS_IMAGE_COUNT);
+    swapChainImages.resize(imageCount);
+    offscreenAllocations.resize(imageCount);
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        createImage(swapChainExtent.width, swapChainExtent.height, swapChainImageFormat,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY,
+            swapChainImages[i], offscreenAllocations[i], MemoryCategory::RenderTarget);
+    }
+
+    std::cout << "Headless: " << imageCount << " offscreen targets, " << swapChainExtent.width << "x" << swapChainExtent.height << std::endl;
 }
 
 void SwapChainService::createImageViews() {
@@ -101,7 +149,7 @@ void SwapChainService::createDepthResources() {
         VK_IMAGE_TILING_OPTIMAL, 
         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
         VMA_MEMORY_USAGE_GPU_ONLY, 
-        depthImage, depthImageAllocation);
+        depthImage, depthImageAllocation, MemoryCategory::Depth);
 
     // 2. Create the Image View
     VkImageViewCreateInfo viewInfo{};
@@ -133,7 +181,7 @@ VkFormat SwapChainService::findDepthFormat() {
     throw std::runtime_error("Failed to find supported depth format!");
 }
 
-void SwapChainService::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage, VkImage& image, VmaAllocation& allocation) {
+void SwapChainService::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage, VkImage& image, VmaAllocation& allocation, MemoryCategory category) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -155,9 +203,16 @@ void SwapChainService::createImage(uint32_t width, uint32_t height, VkFormat for
     if (vmaCreateImage(deviceService.getAllocator(), &imageInfo, &allocInfo, &image, &allocation, nullptr) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create image!");
     }
+    deviceService.getMemoryBudget().track(allocation, category);
 }
 
 VkResult SwapChainService::acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex) {
+    if (headless) {
+        *imageIndex = nextOffscreenImage;
+        nextOffscreenImage = (nextOffscreenImage + 1) % swapChainImages.size();
+        return VK_SUCCESS;
+    }
+
     return vkAcquireNextImageKHR(
         deviceService.device(), 
         swapChain, 
@@ -178,9 +233,26 @@ VkSurfaceFormatKHR SwapChainService::chooseSwapSurfaceFormat(const std::vector<V
 }
 
 VkPresentModeKHR SwapChainService::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
+    // Most wanted first, FIFO is guaranteed so it always ends the list
+    std::vector<VkPresentModeKHR> preferred;
+    switch (presentPolicy) {
+        case PresentPolicy::Vsync:
+            break;
+        case PresentPolicy::VsyncRelaxed:
+            preferred = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+            break;
+        case PresentPolicy::Mailbox:
+            preferred = {VK_PRESENT_MODE_MAILBOX_KHR};
+            break;
+        case PresentPolicy::Immediate:
+        case PresentPolicy::Capped:
+            preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+            break;
+    }
+
+    for (VkPresentModeKHR mode : preferred) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end()) {
+            return mode;
         }
     }
     return VK_PRESENT_MODE_FIFO_KHR;
@@ -200,16 +272,29 @@ VkExtent2D SwapChainService::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& ca
 void SwapChainService::cleanupSwapChain() {
     // 1. Destroy Depth Resources (NEW)
     vkDestroyImageView(deviceService.device(), depthImageView, nullptr);
+    deviceService.getMemoryBudget().untrack(depthImageAllocation);
     vmaDestroyImage(deviceService.getAllocator(), depthImage, depthImageAllocation);
 
     // 2. Destroy Color Resources
     for (auto imageView : swapChainImageViews) {
         vkDestroyImageView(deviceService.device(), imageView, nullptr);
     }
-    vkDestroySwapchainKHR(deviceService.device(), swapChain, nullptr);
+    for (size_t i = 0; i < offscreenAllocations.size(); i++) {
+        deviceService.getMemoryBudget().untrack(offscreenAllocations[i]);
+        vmaDestroyImage(deviceService.getAllocator(), swapChainImages[i], offscreenAllocations[i]);
+    }
+    if (swapChain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(deviceService.device(), swapChain, nullptr);
+    }
 }
 
 void SwapChainService::recreateSwapChain() {
+    AURELIUS_TRACE("SwapChainService::recreateSwapChain");
+    // Offscreen targets never go out of date
+    if (headless) {
+        return;
+    }
+
     int width = 0, height = 0;
     glfwGetFramebufferSize(windowService.getGLFWwindow(), &width, &height);
     while (width == 0 || height == 0) {
@@ -217,11 +302,20 @@ void SwapChainService::recreateSwapChain() {
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(deviceService.device());
+    // No GPU drain: the frames in flight still own the old attachments, so they are destroyed
+    // once the graphics timeline passes the next frame submit
+    DeletionQueue& deletionQueue = deviceService.getDeletionQueue();
+    deletionQueue.destroyImageView(depthImageView);
+    deletionQueue.destroyImage(depthImage, depthImageAllocation);
+    for (auto imageView : swapChainImageViews) {
+        deletionQueue.destroyImageView(imageView);
+    }
 
-    cleanupSwapChain();
+    // The old swapchain is retired by passing it along, it only gets destroyed with the rest
+    VkSwapchainKHR oldSwapChain = swapChain;
+    createSwapChain(oldSwapChain);
+    deletionQueue.destroySwapchain(oldSwapChain);
 
-    createSwapChain();
     createImageViews();
     createDepthResources();
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "../include/Tracer.h"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+Tracer& Tracer::get() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    // Buffers live as long as the tracer, so the cached pointer never dangles
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffer = &registerThread(static_cast<uint32_t>(buffers.size()) + 1);
+    }
+    return *buffer;
+}
+
+Tracer::ThreadBuffer& Tracer::registerThread(uint32_t threadId) {
+    buffers.push_back(std::make_unique<ThreadBuffer>());
+    ThreadBuffer& buffer = *buffers.back();
+    buffer.threadId = threadId;
+    buffer.name = "Thread " + std::to_string(threadId);
+    return buffer;
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffer.name = name;
+}
+
+void Tracer::push(ThreadBuffer& buffer, const char* name, uint64_t startNs, uint64_t endNs) {
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index % EVENTS_PER_THREAD] = {name, startNs, endNs};
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::record(const char* name, uint64_t startNs, uint64_t endNs) {
+    push(threadBuffer(), name, startNs, endNs);
+}
+
+void Tracer::recordGpu(const char* name, uint64_t startNs, uint64_t endNs) {
+    // Only the main thread reads GPU results back, so it is the only writer here too
+    if (gpuBuffer != nullptr) {
+        push(*gpuBuffer, name, startNs, endNs);
+    }
+}
+
+void Tracer::startCapture(uint32_t frameCount, const std::string& path) {
+    if (isCapturing() || frameCount == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        if (gpuBuffer == nullptr) {
+            gpuBuffer = &registerThread(0);
+            gpuBuffer->name = "GPU";
+        }
+    }
+
+    capturePath = path;
+    framesLeft = frameCount;
+    drainFramesLeft = 0;
+    captureStartNs = now();
+    captureEndNs = UINT64_MAX;
+    capturing.store(true, std::memory_order_relaxed);
+
+    std::cout << "\nTracing " << frameCount << " frames to " << path << std::endl;
+}
+
+void Tracer::endFrame() {
+    if (!isCapturing()) {
+        return;
+    }
+
+    // Keeps recording a few frames past the end so the GPU scopes of the last captured frames come in,
+    // everything after captureEndNs is dropped from the dump
+    if (framesLeft > 0) {
+        if (--framesLeft == 0) {
+            captureEndNs = now();
+            drainFramesLeft = GPU_READBACK_FRAMES;
+        }
+        return;
+    }
+
+    if (--drainFramesLeft == 0) {
+        capturing.store(false, std::memory_order_relaxed);
+        writeCapture();
+    }
+}
+
+void Tracer::writeCapture() {
+    std::ofstream file(capturePath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open trace file " << capturePath << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    size_t eventCount = 0;
+    bool first = true;
+    auto separator = [&]() -> std::ofstream& {
+        if (!first) {
+            file << ",\n";
+        }
+        first = false;
+        return file;
+    };
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << std::fixed << std::setprecision(3);
+
+    for (const auto& buffer : buffers) {
+        separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+                    << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+
+        // Anything older than one ring's worth has been overwritten. capturing is already off, but scopes that were
+        // open when it went off still push (worker jobs, pipeline compiles) without taking the mutex, into the slots
+        // right after end, i.e. the oldest ones. Those are skipped. A thread pushing more than DUMP_SLACK_EVENTS
+        // while the dump runs could still hand us a torn event, which we accept for a debugging tool.
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t window = EVENTS_PER_THREAD - DUMP_SLACK_EVENTS;
+        uint64_t begin = end > window ? end - window : 0;
+        const char* category = buffer.get() == gpuBuffer ? "gpu" : "cpu";
+
+        for (uint64_t i = begin; i < end; i++) {
+            const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+            if (event.startNs < captureStartNs || event.startNs > captureEndNs) {
+                continue;
+            }
+
+            separator() << "{\"name\":\"" << event.name << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                        << ",\"ts\":" << (event.startNs - captureStartNs) / 1000.0
+                        << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+            eventCount++;
+        }
+    }
+
+    file << "\n]}\n";
+
+    std::cout << "Trace written to " << capturePath << " (" << eventCount << " events)" << std::endl;
+}
\ No newline at end of file
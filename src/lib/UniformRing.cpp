@@ -0,0 +1,65 @@
+#include "../include/UniformRing.h"
+#include <algorithm>
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformRing::UniformRing(DeviceService& device, uint32_t framesInFlight, VkDeviceSize size) : deviceService(device) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(deviceService.physicalDevice(), &properties);
+    // Both limits are powers of two, so the larger one satisfies either descriptor type
+    alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+    // Each region has to start on an aligned offset too
+    frameSize = alignUp(size, alignment);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = frameSize * framesInFlight;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocInfo = {};
+    allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo{};
+    if (vmaCreateBuffer(deviceService.getAllocator(), &bufferInfo, &allocInfo, &buffer, &allocation, &allocationInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create uniform ring!");
+    }
+    deviceService.getMemoryBudget().track(allocation, MemoryCategory::Uniform);
+    mapped = static_cast<char*>(allocationInfo.pMappedData);
+}
+
+UniformRing::~UniformRing() {
+    // The owner has drained the graphics queue by now
+    deviceService.getMemoryBudget().untrack(allocation);
+    vmaDestroyBuffer(deviceService.getAllocator(), buffer, allocation);
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex) {
+    frameBase = frameSize * frameIndex;
+    head = frameBase;
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size, VkDeviceSize elementAlignment) {
+    VkDeviceSize offset = frameBase + alignUp(head - frameBase, std::max(alignment, elementAlignment));
+    VkDeviceSize end = offset + alignedSize(size);
+    if (end > frameBase + frameSize) {
+        throw std::runtime_error("Uniform ring is out of space!");
+    }
+
+    head = end;
+    return {offset, mapped + offset};
+}
+
+void UniformRing::flush() {
+    if (head > frameBase) {
+        vmaFlushAllocation(deviceService.getAllocator(), allocation, frameBase, head - frameBase);
+    }
+}
+
+VkDeviceSize UniformRing::alignedSize(VkDeviceSize size) const {
+    return alignUp(size, alignment);
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "../include/UploadService.h"
+#include "../include/Tracer.h"
+#include <stdexcept>
+
+UploadService::UploadService(DeviceService& device, FrameScheduler& scheduler) : deviceService(device), frameScheduler(scheduler) {
+    QueueFamilyIndices indices = deviceService.findPhysicalQueueFamilies();
+    graphicsFamily = indices.graphicsFamily.value();
+    transferFamily = indices.transferFamily.value();
+}
+
+UploadService::~UploadService() {
+    // Anything still recorded has to land before the staging memory goes away
+    wait(flush());
+    collectCompletedBatches();
+
+    if (!freeCommandBuffers.empty()) {
+        vkFreeCommandBuffers(deviceService.device(), deviceService.getTransferCommandPool(),
+            static_cast<uint32_t>(freeCommandBuffers.size()), freeCommandBuffers.data());
+    }
+}
+
+void UploadService::beginBatch() {
+    collectCompletedBatches();
+
+    // Reuse a retired command buffer when we have one
+    if (freeCommandBuffers.empty()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = deviceService.getTransferCommandPool();
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(deviceService.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate upload command buffer!");
+        }
+        freeCommandBuffers.push_back(commandBuffer);
+    }
+
+    openBatch.commandBuffer = freeCommandBuffers.back();
+    freeCommandBuffers.pop_back();
+    openBatch.timelineValue = frameScheduler.pendingValue(QueueType::Transfer);
+
+    vkResetCommandBuffer(openBatch.commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(openBatch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin upload command buffer!");
+    }
+
+    batchOpen = true;
+}
+
+UploadTicket UploadService::enqueueCopy(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region, VkSharingMode dstSharingMode) {
+    if (!batchOpen) {
+        beginBatch();
+    }
+
+    vkCmdCopyBuffer(openBatch.commandBuffer, srcBuffer, dstBuffer, 1, &region);
+
+    // Separate queue families need an ownership transfer (release here, acquire on graphics).
+    // With a shared family the semaphore wait on the graphics submit is enough.
+    if (graphicsFamily != transferFamily && dstSharingMode == VK_SHARING_MODE_EXCLUSIVE) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0; // Ignored during release
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.buffer = dstBuffer;
+        barrier.offset = region.dstOffset;
+        barrier.size = region.size;
+        openBatch.ownershipBarriers.push_back(barrier);
+    }
+
+    return {openBatch.timelineValue};
+}
+
+void UploadService::releaseAfterUpload(VkBuffer buffer, VmaAllocation allocation) {
+    if (!batchOpen) {
+        beginBatch();
+    }
+    openBatch.stagingBuffers.emplace_back(buffer, allocation);
+}
+
+UploadTicket UploadService::flush() {
+    AURELIUS_TRACE("UploadService::flush");
+    if (!batchOpen) {
+        return {frameScheduler.lastSubmittedValue(QueueType::Transfer)};
+    }
+
+    // One barrier call releases every buffer in the batch
+    if (!openBatch.ownershipBarriers.empty()) {
+        vkCmdPipelineBarrier(
+            openBatch.commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            static_cast<uint32_t>(openBatch.ownershipBarriers.size()), openBatch.ownershipBarriers.data(),
+            0, nullptr);
+    }
+
+    if (vkEndCommandBuffer(openBatch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record upload command buffer!");
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &openBatch.timelineValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &openBatch.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    VkSemaphore timelineSemaphore = frameScheduler.getTimeline(QueueType::Transfer);
+    submitInfo.pSignalSemaphores = &timelineSemaphore;
+
+    if (vkQueueSubmit(deviceService.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit upload batch!");
+    }
+    frameScheduler.markSubmitted(QueueType::Transfer);
+
+    // Hand the acquire half to the graphics queue, which will record it into the next frame
+    for (VkBufferMemoryBarrier barrier : openBatch.ownershipBarriers) {
+        barrier.srcAccessMask = 0; // Ignored during acquire
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        pendingAcquireBarriers.push_back(barrier);
+    }
+    openBatch.ownershipBarriers.clear();
+
+    UploadTicket ticket{openBatch.timelineValue};
+
+    inFlightBatches.push_back(std::move(openBatch));
+    openBatch = Batch{};
+    batchOpen = false;
+
+    return ticket;
+}
+
+uint64_t UploadService::recordAcquireBarriers(VkCommandBuffer commandBuffer) {
+    uint64_t lastSubmittedValue = frameScheduler.lastSubmittedValue(QueueType::Transfer);
+    if (lastSubmittedValue == lastAcquiredValue) {
+        return 0;
+    }
+
+    if (!pendingAcquireBarriers.empty()) {
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            0,
+            0, nullptr,
+            static_cast<uint32_t>(pendingAcquireBarriers.size()), pendingAcquireBarriers.data(),
+            0, nullptr);
+        pendingAcquireBarriers.clear();
+    }
+
+    lastAcquiredValue = lastSubmittedValue;
+    return lastAcquiredValue;
+}
+
+bool UploadService::isComplete(UploadTicket ticket) {
+    return frameScheduler.isComplete(QueueType::Transfer, ticket.value);
+}
+
+void UploadService::wait(UploadTicket ticket) {
+    AURELIUS_TRACE("UploadService::wait");
+    // Waiting on the open batch would never return, so push it out first
+    if (batchOpen && ticket.value >= openBatch.timelineValue) {
+        flush();
+    }
+
+    frameScheduler.wait(QueueType::Transfer, ticket.value);
+}
+
+void UploadService::collectCompletedBatches() {
+    if (inFlightBatches.empty()) {
+        return;
+    }
+
+    uint64_t completed = frameScheduler.completedValue(QueueType::Transfer);
+    while (!inFlightBatches.empty() && inFlightBatches.front().timelineValue <= completed) {
+        Batch& batch = inFlightBatches.front();
+        for (auto& [buffer, allocation] : batch.stagingBuffers) {
+            deviceService.getMemoryBudget().untrack(allocation);
+            vmaDestroyBuffer(deviceService.getAllocator(), buffer, allocation);
+        }
+        freeCommandBuffers.push_back(batch.commandBuffer);
+        inFlightBatches.pop_front();
+    }
+}
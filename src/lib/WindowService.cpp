@@ -1,11 +1,17 @@
 #include "../include/WindowService.h"
 #include <stdexcept>
+#include <algorithm>
 
-WindowService::WindowService(int w, int h, std::string name) : width(w), height(h), windowName(name) {
-    initWindow();
+WindowService::WindowService(int w, int h, std::string name, bool headless) : width(w), height(h), windowName(name), headless(headless) {
+    if (!headless) {
+        initWindow();
+    }
 }
 
 WindowService::~WindowService() {
+    if (headless) {
+        return;
+    }
     glfwDestroyWindow(window);
     glfwTerminate();
 }
@@ -18,9 +24,29 @@ void WindowService::initWindow() {
 
     glfwSetWindowUserPointer(window, this);
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    glfwSetKeyCallback(window, keyCallback);
+}
+
+void WindowService::pollEvents() {
+    pressedKeys.clear();
+    if (!headless) {
+        glfwPollEvents();
+    }
+}
+
+bool WindowService::wasKeyPressed(int key) {
+    auto it = std::find(pressedKeys.begin(), pressedKeys.end(), key);
+    if (it == pressedKeys.end()) {
+        return false;
+    }
+    pressedKeys.erase(it);
+    return true;
 }
 
 void WindowService::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) {
+    if (headless) {
+        throw std::runtime_error("Headless windows have no surface!");
+    }
     if (glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface!");
     }
@@ -29,4 +55,12 @@ void WindowService::createWindowSurface(VkInstance instance, VkSurfaceKHR* surfa
 void WindowService::framebufferResizeCallback(GLFWwindow* window, int width, int height) {
     auto app = reinterpret_cast<WindowService*>(glfwGetWindowUserPointer(window));
     app->framebufferResized = true;
+}
+
+void WindowService::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS) {
+        return;
+    }
+    auto app = reinterpret_cast<WindowService*>(glfwGetWindowUserPointer(window));
+    app->pressedKeys.push_back(key);
 }
\ No newline at end of file
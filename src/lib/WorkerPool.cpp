@@ -0,0 +1,91 @@
+#include "../include/WorkerPool.h"
+#include "../include/Tracer.h"
+#include <algorithm>
+#include <exception>
+
+WorkerPool::WorkerPool(uint32_t workerCount) {
+    workerCount = std::max(workerCount, 1u);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+uint32_t WorkerPool::defaultWorkerCount() {
+    uint32_t cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void WorkerPool::parallelFor(uint32_t jobCount, const std::function<void(uint32_t jobIndex)>& job) {
+    if (jobCount == 0) {
+        return;
+    }
+
+    uint32_t remaining = jobCount;
+    std::exception_ptr firstError;
+    std::mutex doneMutex;
+    std::condition_variable done;
+
+    for (uint32_t i = 0; i < jobCount; i++) {
+        submit([&, i]() {
+            std::exception_ptr error;
+            try {
+                job(i);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (error && !firstError) {
+                firstError = error;
+            }
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&]() { return remaining == 0; });
+
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+void WorkerPool::workerLoop() {
+    Tracer::get().setThreadName("Worker");
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        AURELIUS_TRACE("WorkerPool::job");
+        job();
+    }
+}
\ No newline at end of file
@@ -2,12 +2,55 @@
 #include <exception>
 #include <iostream>
 #include <ostream>
+#include <stdexcept>
+#include <string>
 
 #include "include/Engine.h"
 
-int main() {
+static PresentPolicy parsePresentPolicy(const std::string& name) {
+    for (PresentPolicy policy : {PresentPolicy::Vsync, PresentPolicy::VsyncRelaxed, PresentPolicy::Mailbox, PresentPolicy::Immediate, PresentPolicy::Capped}) {
+        if (name == presentPolicyName(policy)) {
+            return policy;
+        }
+    }
+    throw std::runtime_error("Unknown present policy: " + name);
+}
+
+// --frames-in-flight N, --swapchain-images N, --present vsync|relaxed|mailbox|immediate|capped, --fps-cap FPS,
+// --trace FRAMES, --trace-path FILE, --headless, --frames N, --bindless
+static EngineConfig parseArgs(int argc, char** argv) {
+    EngineConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames-in-flight" && i + 1 < argc) {
+            config.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--swapchain-images" && i + 1 < argc) {
+            config.swapChainImageCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--present" && i + 1 < argc) {
+            config.presentPolicy = parsePresentPolicy(argv[++i]);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            config.traceFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--trace-path" && i + 1 < argc) {
+            config.tracePath = argv[++i];
+        } else if (arg == "--headless") {
+            config.headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            config.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--bindless") {
+            config.bindless = true;
+        } else if (arg == "--fps-cap" && i + 1 < argc) {
+            config.presentPolicy = PresentPolicy::Capped;
+            config.fpsCap = std::stod(argv[++i]);
+        } else {
+            throw std::runtime_error("Unknown argument: " + arg);
+        }
+    }
+    return config;
+}
+
+int main(int argc, char** argv) {
     try {
-        Engine app;
+        Engine app{parseArgs(argc, argv)};
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
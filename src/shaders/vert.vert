@@ -6,14 +6,32 @@ layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+// Written by the engine once per frame, shared by every draw
+layout(set = 0, binding = 0) uniform FrameConstants {
     mat4 view;
     mat4 proj;
-} ubo;
+    mat4 viewProj;
+    float time;
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 color;
+};
+
+// This frame's objects, CommandService writes them in draw order
+layout(std430, set = 1, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// Pushed by CommandService for every instanced draw, the index of its first instance's object
+layout(push_constant) uniform DrawConstants {
+    uint objectIndex;
+} draw;
 
 void main() {
     // REMOVE the manual 0.0 z-value. Use inPosition directly.
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragColor = inColor;
+    ObjectData object = objects[draw.objectIndex + gl_InstanceIndex];
+    gl_Position = frame.viewProj * object.model * vec4(inPosition, 1.0);
+    fragColor = inColor * object.color.rgb;
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Bindless variant of vert.vert: no object set, the object data is looked up in the global
+// set (set 1) through the storage buffer slot in the push constants
+
+layout(location = 0) in vec3 inPosition; 
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(set = 0, binding = 0) uniform FrameConstants {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    float time;
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 color;
+};
+
+// Every storage buffer in the global set, the sampled images (binding 1) and samplers (binding 2) go unused here
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffers {
+    ObjectData objects[];
+} objectBuffers[];
+
+layout(push_constant) uniform BindlessConstants {
+    uint objectBuffer;
+} constants;
+
+void main() {
+    // firstInstance is the draw's index into this frame's object buffer
+    ObjectData object = objectBuffers[constants.objectBuffer].objects[gl_InstanceIndex];
+    gl_Position = frame.viewProj * object.model * vec4(inPosition, 1.0);
+    fragColor = inColor * object.color.rgb;
+}
\ No newline at end of file
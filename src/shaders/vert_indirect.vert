@@ -0,0 +1,37 @@
+#version 450
+
+// GPU-driven variant of vert.vert: the transform comes from the object buffer the culling pass read,
+// indexed by the firstInstance it wrote into the draw command
+
+layout(location = 0) in vec3 inPosition; 
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(set = 0, binding = 0) uniform FrameConstants {
+    mat4 view;
+    mat4 proj;
+    mat4 viewProj;
+    float time;
+} frame;
+
+struct ObjectData {
+    mat4 model;
+    vec4 boundingSphere;
+    vec4 color;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint batch;
+    uint drawBase;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+void main() {
+    ObjectData object = objects[gl_InstanceIndex];
+    gl_Position = frame.viewProj * object.model * vec4(inPosition, 1.0);
+    fragColor = inColor * object.color.rgb;
+}
\ No newline at end of file